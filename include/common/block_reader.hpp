@@ -0,0 +1,62 @@
+/* block_reader - Buffered sequential reads of fixed size values
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file block_reader.hpp
+   \brief block_reader.hpp Buffered sequential reads of fixed size values from a position of a file, a block at a time
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#ifndef _BLOCK_READER_HH
+#define _BLOCK_READER_HH
+
+#include <common.hpp>
+
+template < class value_t >
+class block_reader
+{
+public:
+    /*
+     * \param File descriptor open for reading, not closed by the reader
+     * \param Index of the first value to read
+     * \param Values of the buffer
+     */
+    block_reader(int fd, size_t first, size_t block_size) : fd(fd), pos(first * sizeof(value_t)), buffer(std::max((size_t) 1, block_size)) {}
+
+    // Next value of the file, which must not be past its end
+    value_t next()
+    {
+        if (i == filled) fill();
+        return buffer[i++];
+    }
+
+private:
+    void fill()
+    {
+        size_t bytes = pread_all(fd, (char *) buffer.data(), buffer.size() * sizeof(value_t), pos);
+        if (bytes < sizeof(value_t)) error("Read past the end of the file");
+
+        pos += bytes;
+        filled = bytes / sizeof(value_t);
+        i = 0;
+    }
+
+    int fd;
+    off_t pos;
+    std::vector<value_t> buffer;
+    size_t filled = 0;
+    size_t i = 0;
+};
+
+#endif /* end of include guard: _BLOCK_READER_HH */
@@ -0,0 +1,82 @@
+/* block_writer - Double buffered positioned writes in the background
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file block_writer.hpp
+   \brief block_writer.hpp Double buffered positioned writes, one block written in the background while the next is filled
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#ifndef _BLOCK_WRITER_HH
+#define _BLOCK_WRITER_HH
+
+#include <common.hpp>
+
+#include <future>
+
+class block_writer
+{
+public:
+    /*
+     * \param File descriptor open for writing, not closed by the writer
+     * \param Bytes of each of the two buffers
+     */
+    block_writer(int fd, size_t block_size) : fd(fd), current(block_size), flushing(block_size) {}
+
+    block_writer(const block_writer &) = delete;
+    block_writer &operator=(const block_writer &) = delete;
+
+    ~block_writer()
+    {
+        wait();
+    }
+
+    // Buffer to fill, valid until the next flush
+    char *data()
+    {
+        return current.data();
+    }
+
+    size_t block_size() const
+    {
+        return current.size();
+    }
+
+    /*
+     * Writes bytes [from, from + len) of the buffer at position pos of the file in the background, and switches to
+     * the other buffer once the previous write has finished
+     */
+    void flush(size_t from, size_t len, off_t pos)
+    {
+        wait();
+        std::swap(current, flushing);
+
+        const char *buf = flushing.data() + from;
+        pending = std::async(std::launch::async, [this, buf, len, pos]() { pwrite_all(fd, buf, len, pos); });
+    }
+
+    // Waits for the write in the background, if any
+    void wait()
+    {
+        if (pending.valid()) pending.get();
+    }
+
+private:
+    int fd;
+    std::vector<char> current;
+    std::vector<char> flushing;
+    std::future<void> pending;
+};
+
+#endif /* end of include guard: _BLOCK_WRITER_HH */
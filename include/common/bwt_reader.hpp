@@ -0,0 +1,190 @@
+/* bwt_reader - Memory mapped plain BWT, read as runs
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file bwt_reader.hpp
+   \brief bwt_reader.hpp Memory mapped plain BWT, finding runs with vector compares in parallel chunks
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#ifndef _BWT_READER_HH
+#define _BWT_READER_HH
+
+#include <common.hpp>
+#include <mapped_file.hpp>
+#include <parallel.hpp>
+
+#include <immintrin.h>
+
+// Characters per chunk, each searched for runs by one thread
+#define BWT_CHUNK (1 << 22)
+
+// Runs (character, length) of a chunk, the first and last possibly continuing in the neighbouring chunks
+typedef std::vector<std::pair<char, ulint>> chunk_runs;
+
+using find_runs_fn = void (*)(const char *bwt, ulint begin, ulint end, chunk_runs &out);
+
+// Characters up to the terminator (including those above 127, as signed chars) are read as the terminator
+inline char bwt_char(char c)
+{
+    return (c <= (char) TERMINATOR) ? TERMINATOR : c;
+}
+
+inline void find_runs_scalar(const char *bwt, ulint begin, ulint end, chunk_runs &out)
+{
+    if (begin >= end) return;
+
+    ulint head = begin;
+    for (ulint i = begin + 1; i < end; ++i)
+    {
+        if (bwt_char(bwt[i]) != bwt_char(bwt[i - 1]))
+        {
+            out.emplace_back(bwt_char(bwt[head]), i - head);
+            head = i;
+        }
+    }
+    out.emplace_back(bwt_char(bwt[head]), end - head);
+}
+
+/*
+ * Compares 32 characters with the characters before them, after a signed max with 1 maps the terminator, zero and
+ * characters above 127 to 1. The movemask of the inequalities has a bit set at each run head.
+ */
+__attribute__((target("avx2")))
+inline void find_runs_avx2(const char *bwt, ulint begin, ulint end, chunk_runs &out)
+{
+    if (begin >= end) return;
+
+    const __m256i terminator = _mm256_set1_epi8(TERMINATOR);
+
+    ulint head = begin;
+    ulint i = begin + 1;
+    for (; i + 32 <= end; i += 32)
+    {
+        __m256i curr = _mm256_max_epi8(_mm256_loadu_si256((const __m256i *) (bwt + i)), terminator);
+        __m256i prev = _mm256_max_epi8(_mm256_loadu_si256((const __m256i *) (bwt + i - 1)), terminator);
+        uint32_t heads = ~(uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(curr, prev));
+
+        while (heads)
+        {
+            ulint next = i + __builtin_ctz(heads);
+            out.emplace_back(bwt_char(bwt[head]), next - head);
+            head = next;
+            heads &= heads - 1;
+        }
+    }
+
+    for (; i < end; ++i)
+    {
+        if (bwt_char(bwt[i]) != bwt_char(bwt[i - 1]))
+        {
+            out.emplace_back(bwt_char(bwt[head]), i - head);
+            head = i;
+        }
+    }
+    out.emplace_back(bwt_char(bwt[head]), end - head);
+}
+
+inline find_runs_fn select_find_runs()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return find_runs_avx2;
+    return find_runs_scalar;
+}
+
+class bwt_reader
+{
+public:
+    /*
+     * \param Path of the BWT
+     * \param Threads searching chunks for runs
+     * \param Read the whole file into memory when mapping, instead of faulting pages in on access
+     */
+    bwt_reader(std::string bwt_fname, ulint threads = 1, bool populate = false) : bwt(bwt_fname, populate), threads(std::max((ulint) 1, threads))
+    {
+        // A FIFO is read whole into memory, run-length encode it with rlbwt_reader(std::istream&) to keep only its runs
+        mapped_file::read_streams({&bwt});
+        bwt.advise(MADV_SEQUENTIAL);
+    }
+
+    // Length of the BWT
+    ulint size() const
+    {
+        return bwt.size();
+    }
+
+    /*
+     * Calls emit(c, length) for every run in order. Each round, threads search consecutive chunks for runs, and the
+     * runs of the chunks are emitted in order, joining runs continuing across chunk boundaries.
+     * \return Number of runs
+     */
+    template < class emit_t >
+    ulint for_each_run(emit_t emit) const
+    {
+        const char *data = bwt.data();
+        ulint n = size();
+
+        std::vector<chunk_runs> chunks(threads);
+        ulint runs = 0;
+        char last_c = 0;
+        ulint length = 0;
+
+        for (ulint start = 0; start < n; start += threads * BWT_CHUNK)
+        {
+            parallel_for(threads, threads, [&](ulint t) {
+                ulint begin = std::min(n, start + t * BWT_CHUNK);
+                ulint end = std::min(n, begin + BWT_CHUNK);
+
+                chunks[t].clear();
+                find_runs(data, begin, end, chunks[t]);
+            });
+
+            for (ulint t = 0; t < threads; ++t)
+            {
+                for (std::pair<char, ulint> &run : chunks[t])
+                {
+                    if (length != 0 && run.first == last_c)
+                    {
+                        length += run.second;
+                        continue;
+                    }
+
+                    if (length != 0)
+                    {
+                        emit(last_c, length);
+                        ++runs;
+                    }
+                    last_c = run.first;
+                    length = run.second;
+                }
+            }
+        }
+
+        if (length != 0)
+        {
+            emit(last_c, length);
+            ++runs;
+        }
+
+        return runs;
+    }
+
+private:
+    mapped_file bwt;
+    ulint threads;
+
+    find_runs_fn find_runs = select_find_runs();
+};
+
+#endif /* end of include guard: _BWT_READER_HH */
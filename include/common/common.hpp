@@ -32,12 +32,15 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 
+#include <fstream>
 #include <sstream>      // std::stringstream
 #include <vector>      // std::vector
 #include <chrono>       // high_resolution_clock
 #include <algorithm> 
 #include <utility> 
 #include <assert.h>
+#include <cerrno>
+#include <cstring>
 
 #include <sdsl/int_vector.hpp>
 
@@ -123,8 +126,18 @@ void _internal_messageError( const std::string file, const unsigned int line,
 struct Args
 {
   std::string filename = "";
-  bool rle   = true; // read in RLBWT
+  bool rle   = true; // read in RLBWT (heads and lengths), otherwise the plain BWT
   int d = 2; // splitting param
+  bool packed = false; // store bit-packed table
+  bool mapped = false; // store or read table in the mapped layout
+  ulint sample_period = 0; // steps between text samples, 0 to not sample
+  ulint threads = 1; // threads for parallel phases
+  bool forward = false; // write inverted text first character first
+  bool low_memory = false; // build in two passes, with rows allocated once
+  bool checkpoint = false; // also write intermediate results of fused builds
+  ulint budget = 0; // MB buffered by an external build, 0 to build in memory
+  bool stream = false; // read the plain BWT from standard input, keeping only its runs
+  bool offline = false; // split runs with offline_balance instead of deterministic
 };
 
 void parseArgs(int argc, char *const argv[], Args &arg)
@@ -134,17 +147,53 @@ void parseArgs(int argc, char *const argv[], Args &arg)
   extern int optind;
 
   std::string sarg;
-  while ((c = getopt(argc, argv, "rd:")) != -1)
+  while ((c = getopt(argc, argv, "rbd:pms:t:flce:io")) != -1)
   {
     switch (c)
     {
     case 'r':
       arg.rle = true;
       break;
+    case 'b':
+      arg.rle = false;
+      break;
     case 'd':
       sarg.assign(optarg);
       arg.d = stoi(sarg);
       break;
+    case 'p':
+      arg.packed = true;
+      break;
+    case 'm':
+      arg.mapped = true;
+      break;
+    case 's':
+      sarg.assign(optarg);
+      arg.sample_period = stoul(sarg);
+      break;
+    case 't':
+      sarg.assign(optarg);
+      arg.threads = stoul(sarg);
+      break;
+    case 'f':
+      arg.forward = true;
+      break;
+    case 'l':
+      arg.low_memory = true;
+      break;
+    case 'c':
+      arg.checkpoint = true;
+      break;
+    case 'e':
+      sarg.assign(optarg);
+      arg.budget = stoul(sarg);
+      break;
+    case 'i':
+      arg.stream = true;
+      break;
+    case 'o':
+      arg.offline = true;
+      break;
     case '?':
       error("Unknown option.\n");
       break;
@@ -184,4 +233,64 @@ uint8_t bitsize(uint64_t x){
 
 }
 
+// Position of the first set bit of bv in [from, to), or to if there is none (also past the end of bv), skipping a word of zeros at a time
+ulint next_set_bit(const sdsl::bit_vector &bv, ulint from, ulint to)
+{
+  ulint end = std::min(to, (ulint) bv.size());
+  if (from >= end) return to;
+
+  const uint64_t *words = bv.data();
+  ulint w = from >> 6;
+  uint64_t word = words[w] & (~0ULL << (from & 63));
+  while (word == 0)
+  {
+    if ((++w << 6) >= end) return to;
+    word = words[w];
+  }
+
+  ulint pos = (w << 6) + __builtin_ctzll(word);
+  return (pos < end) ? pos : to;
+}
+
+// Write len bytes of buf at position pos of the file, which may take several calls
+void pwrite_all(int fd, const char *buf, size_t len, off_t pos)
+{
+  while (len > 0)
+  {
+    ssize_t written = pwrite(fd, buf, len, pos);
+    if (written < 0)
+    {
+      if (errno == EINTR) continue;
+      error("Cannot write:", strerror(errno));
+    }
+
+    buf += written;
+    len -= written;
+    pos += written;
+  }
+}
+
+// Read up to len bytes at position pos of the file into buf, stopping early only at the end of the file
+size_t pread_all(int fd, char *buf, size_t len, off_t pos)
+{
+  size_t total = 0;
+  while (len > 0)
+  {
+    ssize_t got = pread(fd, buf, len, pos);
+    if (got < 0)
+    {
+      if (errno == EINTR) continue;
+      error("Cannot read:", strerror(errno));
+    }
+    if (got == 0) break;
+
+    buf += got;
+    len -= got;
+    pos += got;
+    total += got;
+  }
+
+  return total;
+}
+
 #endif /* end of include guard: _COMMON_HH */
\ No newline at end of file
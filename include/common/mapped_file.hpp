@@ -0,0 +1,191 @@
+/* mapped_file - Read-only memory mapping of a file
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file mapped_file.hpp
+   \brief mapped_file.hpp Read-only memory mapping of a file, unmapped when destroyed. Pipes are read into anonymous memory
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#ifndef _MAPPED_FILE_HH
+#define _MAPPED_FILE_HH
+
+#include <common.hpp>
+
+#include <cstring>
+#include <cerrno>
+#include <sys/mman.h>
+#include <poll.h>
+
+// Bytes read from a stream at a time
+#define STREAM_BLOCK (1 << 20)
+
+class mapped_file
+{
+public:
+    // Empty anonymous memory, filled by append
+    mapped_file() {}
+
+    /*
+     * Files that cannot be mapped (a FIFO, or standard input given as "-") are left open, to be read whole into
+     * anonymous memory by read_streams in a single pass, before anything is built from them. A FIFO is opened without
+     * waiting for its writer, so FIFOs may be opened in any order (read_streams waits for them to be written to).
+     * \param Path of the file to map
+     * \param Read the whole file into memory when mapping, instead of faulting pages in on access
+     */
+    mapped_file(std::string fname, bool populate = false)
+    {
+        int fd = (fname == "-") ? dup(STDIN_FILENO) : open(fname.c_str(), O_RDONLY | O_NONBLOCK);
+        if (fd < 0) error("Cannot open", fname, ":", strerror(errno));
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) error("Cannot stat", fname, ":", strerror(errno));
+        if (!S_ISREG(st.st_mode))
+        {
+            // Reads block as usual once poll has found the writer
+            if (fname != "-" && fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK) != 0) error("Cannot read", fname, ":", strerror(errno));
+            stream = fd;
+            return;
+        }
+        length = st.st_size;
+        capacity = length;
+
+        // Empty files cannot be mapped, but are valid inputs
+        if (length > 0)
+        {
+            int flags = MAP_SHARED;
+            if (populate) flags |= MAP_POPULATE;
+
+            addr = mmap(nullptr, length, PROT_READ, flags, fd, 0);
+            if (addr == MAP_FAILED) error("Cannot map", fname, ":", strerror(errno));
+        }
+        close(fd);
+    }
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+
+    ~mapped_file()
+    {
+        if (addr != nullptr) munmap(addr, capacity);
+        if (stream >= 0) close(stream);
+    }
+
+    const char *data() const
+    {
+        return (const char *) addr;
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+    // Hint the expected access pattern of the mapping to the kernel (e.g. MADV_RANDOM, MADV_SEQUENTIAL)
+    void advise(int advice)
+    {
+        if (addr != nullptr) madvise(addr, length, advice);
+    }
+
+    // Adds bytes to the end of anonymous memory
+    void append(const char *bytes, size_t count)
+    {
+        reserve(length + count);
+        memcpy((char *) addr + length, bytes, count);
+        length += count;
+    }
+
+    /*
+     * Reads the files left open to the end, polling them together so that a writer filling them in lockstep (as
+     * pfp-thresholds writes .heads and .len) never blocks on a full pipe. Mapped files are skipped.
+     */
+    static void read_streams(std::initializer_list<mapped_file *> files)
+    {
+        std::vector<mapped_file *> open_files;
+        for (mapped_file *file : files)
+        {
+            if (file->stream >= 0) open_files.push_back(file);
+        }
+
+        std::vector<pollfd> fds(open_files.size());
+        for (size_t i = 0; i < open_files.size(); ++i)
+        {
+            fds[i] = {open_files[i]->stream, POLLIN, 0};
+        }
+
+        size_t remaining = open_files.size();
+        while (remaining > 0)
+        {
+            if (poll(fds.data(), fds.size(), -1) < 0)
+            {
+                if (errno == EINTR) continue;
+                error("Cannot poll streams:", strerror(errno));
+            }
+
+            for (size_t i = 0; i < fds.size(); ++i)
+            {
+                if (fds[i].fd < 0 || fds[i].revents == 0) continue;
+                if (!open_files[i]->read_block())
+                {
+                    fds[i].fd = -1;
+                    --remaining;
+                }
+            }
+        }
+    }
+
+private:
+    // Grows anonymous memory, doubling, to hold at least size bytes
+    void reserve(size_t size)
+    {
+        if (size <= capacity) return;
+
+        size_t grown = std::max(size, std::max((size_t) STREAM_BLOCK, 2 * capacity));
+        void *grown_addr = (addr == nullptr) ? mmap(nullptr, grown, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)
+                                             : mremap(addr, capacity, grown, MREMAP_MAYMOVE);
+        if (grown_addr == MAP_FAILED) error("Cannot grow memory to", grown, "bytes:", strerror(errno));
+
+        addr = grown_addr;
+        capacity = grown;
+    }
+
+    // Reads the next block of the stream, closing it at its end
+    bool read_block()
+    {
+        reserve(length + STREAM_BLOCK);
+
+        ssize_t count = read(stream, (char *) addr + length, STREAM_BLOCK);
+        if (count < 0)
+        {
+            if (errno == EINTR || errno == EAGAIN) return true;
+            error("Cannot read stream:", strerror(errno));
+        }
+        if (count == 0)
+        {
+            close(stream);
+            stream = -1;
+            return false;
+        }
+
+        length += count;
+        return true;
+    }
+
+    void *addr = nullptr;
+    size_t length = 0;
+    size_t capacity = 0; // Bytes mapped, past length for anonymous memory
+    int stream = -1; // Descriptor of a file not yet read, or -1
+};
+
+#endif /* end of include guard: _MAPPED_FILE_HH */
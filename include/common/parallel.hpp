@@ -0,0 +1,67 @@
+/* parallel - Run independent tasks on a fixed number of threads
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file parallel.hpp
+   \brief parallel.hpp Run independent tasks on a fixed number of threads, each taking the next task when it finishes one
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#ifndef _PARALLEL_HH
+#define _PARALLEL_HH
+
+#include <common.hpp>
+
+#include <atomic>
+#include <thread>
+
+/*
+ * Calls task(i) for every 0 <= i < count, on at most threads threads (on the calling thread if only one)
+ * \param Number of tasks
+ * \param Number of threads
+ * \param Function of the task index
+ */
+template < class task_t >
+void parallel_for(ulint count, ulint threads, task_t task)
+{
+    threads = std::min(threads, count);
+    if (threads <= 1)
+    {
+        for (ulint i = 0; i < count; ++i)
+        {
+            task(i);
+        }
+        return;
+    }
+
+    std::atomic<ulint> next(0);
+    std::vector<std::thread> workers;
+    for (ulint t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&]() {
+            ulint i;
+            while ((i = next.fetch_add(1)) < count)
+            {
+                task(i);
+            }
+        });
+    }
+
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+#endif /* end of include guard: _PARALLEL_HH */
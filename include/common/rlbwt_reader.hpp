@@ -0,0 +1,228 @@
+/* rlbwt_reader - Memory mapped run-length BWT (.heads and .len)
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file rlbwt_reader.hpp
+   \brief rlbwt_reader.hpp Memory mapped run-length BWT, decoding run lengths in blocks. Pipes and plain BWT streams are read once into memory
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#ifndef _RLBWT_READER_HH
+#define _RLBWT_READER_HH
+
+#include <common.hpp>
+#include <mapped_file.hpp>
+#include <bwt_reader.hpp>
+
+#include <immintrin.h>
+
+// Bytes of a run length in .len
+#define RLBWT_LENGTH_BYTES 5
+// Runs decoded at a time when iterating
+#define RLBWT_BLOCK (1 << 16)
+
+using decode_fn = void (*)(const char *src, ulint count, ulint *out);
+
+inline void decode_lengths_scalar(const char *src, ulint count, ulint *out)
+{
+    for (ulint i = 0; i < count; ++i)
+    {
+        ulint length = 0;
+        memcpy(&length, src + i * RLBWT_LENGTH_BYTES, RLBWT_LENGTH_BYTES);
+        out[i] = length;
+    }
+}
+
+/*
+ * Each 128 bit lane loads 16 bytes holding two lengths, and a shuffle spreads their 5 bytes into 64 bit words. The
+ * loads read up to 6 bytes past the fourth length, so the last lengths are decoded by the scalar loop.
+ */
+__attribute__((target("avx2")))
+inline void decode_lengths_avx2(const char *src, ulint count, ulint *out)
+{
+    const __m256i spread = _mm256_setr_epi8(0, 1, 2, 3, 4, -1, -1, -1, 5, 6, 7, 8, 9, -1, -1, -1,
+                                            0, 1, 2, 3, 4, -1, -1, -1, 5, 6, 7, 8, 9, -1, -1, -1);
+
+    ulint i = 0;
+    for (; i + 6 <= count; i += 4)
+    {
+        const char *p = src + i * RLBWT_LENGTH_BYTES;
+        __m128i lo = _mm_loadu_si128((const __m128i *) p);
+        __m128i hi = _mm_loadu_si128((const __m128i *) (p + 2 * RLBWT_LENGTH_BYTES));
+        __m256i bytes = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+
+        _mm256_storeu_si256((__m256i *) (out + i), _mm256_shuffle_epi8(bytes, spread));
+    }
+
+    decode_lengths_scalar(src + i * RLBWT_LENGTH_BYTES, count - i, out + i);
+}
+
+inline decode_fn select_decode()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return decode_lengths_avx2;
+    return decode_lengths_scalar;
+}
+
+class rlbwt_reader
+{
+public:
+    /*
+     * Either file may be a FIFO (written by pfp-thresholds as it runs), in which case both are read together into
+     * memory, the runs taking 6 bytes each
+     * \param Path of the BWT, whose runs are read from <BWT>.heads and <BWT>.len
+     * \param Read both files into memory when mapping, instead of faulting pages in on access
+     */
+    rlbwt_reader(std::string bwt_fname, bool populate = false)
+        : heads(bwt_fname + ".heads", populate), lengths(bwt_fname + ".len", populate)
+    {
+        mapped_file::read_streams({&heads, &lengths});
+
+        if (lengths.size() != heads.size() * RLBWT_LENGTH_BYTES)
+        {
+            error("Run lengths of", bwt_fname, "do not match its heads:", lengths.size(), "bytes for", heads.size(), "runs");
+        }
+
+        heads.advise(MADV_SEQUENTIAL);
+        lengths.advise(MADV_SEQUENTIAL);
+    }
+
+    /*
+     * Reads a plain BWT (such as standard input) in one pass, keeping only its runs. Runs are found a block at a time
+     * and joined across blocks.
+     * \param Stream of the BWT
+     */
+    rlbwt_reader(std::istream &bwt)
+    {
+        find_runs_fn find_runs = select_find_runs();
+        std::vector<char> block(BWT_CHUNK);
+        chunk_runs block_runs;
+        std::string block_heads;
+        std::string block_lengths;
+
+        char last_c = 0;
+        ulint length = 0;
+        while (bwt.read(block.data(), block.size()) || bwt.gcount() > 0)
+        {
+            block_runs.clear();
+            find_runs(block.data(), 0, bwt.gcount(), block_runs);
+
+            // The last run may continue in the next block, so it is held back
+            for (std::pair<char, ulint> run : block_runs)
+            {
+                if (length != 0 && run.first == last_c)
+                {
+                    length += run.second;
+                    continue;
+                }
+
+                if (length != 0)
+                {
+                    block_heads.push_back(last_c);
+                    block_lengths.append((char *)&length, RLBWT_LENGTH_BYTES);
+                }
+                last_c = run.first;
+                length = run.second;
+            }
+
+            heads.append(block_heads.data(), block_heads.size());
+            lengths.append(block_lengths.data(), block_lengths.size());
+            block_heads.clear();
+            block_lengths.clear();
+        }
+
+        if (length != 0)
+        {
+            heads.append(&last_c, 1);
+            lengths.append((char *)&length, RLBWT_LENGTH_BYTES);
+        }
+    }
+
+    // Number of runs
+    ulint runs() const
+    {
+        return heads.size();
+    }
+
+    char head(ulint i) const
+    {
+        assert(i < runs());
+        return heads.data()[i];
+    }
+
+    ulint length(ulint i) const
+    {
+        assert(i < runs());
+        ulint length = 0;
+        memcpy(&length, lengths.data() + i * RLBWT_LENGTH_BYTES, RLBWT_LENGTH_BYTES);
+        return length;
+    }
+
+    // Decodes the lengths of runs [first, first + count) into out
+    void decode_lengths(ulint first, ulint count, ulint *out) const
+    {
+        assert(first + count <= runs());
+        decode(lengths.data() + first * RLBWT_LENGTH_BYTES, count, out);
+    }
+
+    // Calls emit(c, length) for every run in order, decoding lengths a block at a time
+    template < class emit_t >
+    void for_each_run(emit_t emit) const
+    {
+        std::vector<ulint> block(std::min((ulint) RLBWT_BLOCK, runs()));
+        const char *head_data = heads.data();
+
+        for (ulint start = 0; start < runs(); start += RLBWT_BLOCK)
+        {
+            ulint count = std::min((ulint) RLBWT_BLOCK, runs() - start);
+            decode_lengths(start, count, block.data());
+
+            for (ulint i = 0; i < count; ++i)
+            {
+                emit(head_data[start + i], block[i]);
+            }
+        }
+    }
+
+private:
+    mapped_file heads;
+    mapped_file lengths;
+
+    decode_fn decode = select_decode();
+};
+
+/*
+ * Writes runs as heads and lengths, read by rlbwt_reader
+ * \param Path of the BWT, writing bwt_fname.heads and bwt_fname.len
+ * \param Function calling its argument emit(c, length) for each run in order, returning the number of runs
+ * \return Number of runs
+ */
+template < class runs_t >
+ulint write_rlbwt(std::string bwt_fname, runs_t runs)
+{
+    std::ofstream heads(bwt_fname + ".heads");
+    std::ofstream lengths(bwt_fname + ".len");
+
+    ulint count = runs([&](char c, ulint length) {
+        heads.put(c);
+        lengths.write((char *)&length, RLBWT_LENGTH_BYTES);
+    });
+
+    heads.close();
+    lengths.close();
+
+    return count;
+}
+
+#endif /* end of include guard: _RLBWT_READER_HH */
@@ -0,0 +1,259 @@
+/* split_positions - Sorted positions where the rows of a splitting start
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file split_positions.hpp
+   \brief split_positions.hpp Splitting of the runs of a BWT held as the sorted positions its rows start at, in O(r) space
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#ifndef _SPLIT_POSITIONS_HH
+#define _SPLIT_POSITIONS_HH
+
+#include <common.hpp>
+#include <block_reader.hpp>
+
+#include <sdsl/int_vector.hpp>
+
+#define SPLITS_MAGIC 0x7374696c70735f64ULL // "d_splits"
+#define SPLITS_VERSION 1
+
+/*
+ * Reads sorted positions one at a time from a source with next(), answering the queries read_runs makes of a
+ * splitting bit vector with next_set_bit, whose starts only move forward.
+ */
+template < class source_t >
+class split_cursor
+{
+public:
+    /*
+     * \param Source of the positions, in order
+     * \param Length of the BWT
+     * \param Number of positions
+     */
+    split_cursor(source_t source, ulint n, ulint count) : source(std::move(source)), n(n), left(count)
+    {
+        step();
+    }
+
+    // Length of the BWT
+    ulint size() const
+    {
+        return n;
+    }
+
+    // First position in [from, to), or to if there is none, from not less than in earlier calls
+    ulint next(ulint from, ulint to)
+    {
+        while (!done && current < from) step();
+        return (!done && current < to) ? current : to;
+    }
+
+private:
+    void step()
+    {
+        if (left == 0)
+        {
+            done = true;
+            return;
+        }
+
+        current = source.next();
+        --left;
+    }
+
+    source_t source;
+    ulint n;
+    ulint left;
+    ulint current = 0;
+    bool done = false;
+};
+
+/*
+ * A row starts at each position held, in increasing order, in a bit-packed vector of O(r) words, where a bit vector
+ * over the BWT takes n bits. A .d_col holds a header (magic, version, n, d, count) and then the positions as 64-bit
+ * words, so an external build streams them through a block_reader rather than loading them.
+ */
+class split_positions
+{
+public:
+    // Words of the header of a .d_col, before its positions
+    static constexpr ulint HEADER_WORDS = 5;
+
+    split_positions() {}
+
+    /*
+     * \param Length of the BWT
+     * \param Sorted positions where rows start
+     * \param Splitting parameter they were built with (0 if unknown)
+     */
+    split_positions(ulint n, sdsl::int_vector<> positions, ulint d = 0) : n(n), d(d), positions(std::move(positions)) {}
+
+    // Set bits of a splitting bit vector
+    split_positions(const sdsl::bit_vector &splits, ulint d = 0) : n(splits.size()), d(d)
+    {
+        ulint count = 0;
+        for (ulint i = next_set_bit(splits, 0, n); i < n; i = next_set_bit(splits, i + 1, n)) ++count;
+
+        positions = sdsl::int_vector<>(count, 0, bitsize(n));
+        count = 0;
+        for (ulint i = next_set_bit(splits, 0, n); i < n; i = next_set_bit(splits, i + 1, n)) positions[count++] = i;
+    }
+
+    // Length of the BWT
+    ulint size() const
+    {
+        return n;
+    }
+
+    // Number of rows
+    ulint count() const
+    {
+        return positions.size();
+    }
+
+    ulint operator[](ulint i) const
+    {
+        return positions[i];
+    }
+
+    ulint split_param() const
+    {
+        return d;
+    }
+
+    // Reads the positions held, in order
+    struct memory_source
+    {
+        const sdsl::int_vector<> *positions;
+        ulint i;
+
+        ulint next()
+        {
+            return (*positions)[i++];
+        }
+    };
+
+    split_cursor<memory_source> cursor() const
+    {
+        return split_cursor<memory_source>({&positions, 0}, n, count());
+    }
+
+    /*
+     * Opens a .d_col to stream its positions, without loading them
+     * \param Path of the splitting
+     * \param Header read, (magic, version, n, d, count)
+     * \return File descriptor, the positions starting after HEADER_WORDS words
+     */
+    static int open_positions(std::string fname, ulint header[HEADER_WORDS])
+    {
+        int fd = open(fname.c_str(), O_RDONLY);
+        if (fd < 0) error("Cannot open splitting", fname);
+
+        size_t bytes = pread_all(fd, (char *)header, HEADER_WORDS * sizeof(ulint), 0);
+        if (bytes < HEADER_WORDS * sizeof(ulint) || header[0] != SPLITS_MAGIC)
+        {
+            error("Splitting", fname, "is a bit vector, written before positions were; write it again to stream it");
+        }
+        if (header[1] != SPLITS_VERSION) error("Splitting", fname, "has version", header[1], "but", SPLITS_VERSION, "is read");
+
+        return fd;
+    }
+
+    /*
+     * Cursor streaming the positions of an open .d_col through a buffer of block values
+     * \param File descriptor from open_positions
+     * \param Header read by open_positions
+     * \param Values buffered
+     */
+    static split_cursor<block_reader<ulint>> file_cursor(int fd, const ulint header[HEADER_WORDS], size_t block)
+    {
+        return split_cursor<block_reader<ulint>>(block_reader<ulint>(fd, HEADER_WORDS, block), header[2], header[4]);
+    }
+
+    /* serialize to the ostream
+    * \param out     the ostream
+    */
+    size_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, std::string name ="") const
+    {
+        ulint header[HEADER_WORDS] = {SPLITS_MAGIC, SPLITS_VERSION, n, d, count()};
+        out.write((char *)header, sizeof(header));
+
+        std::vector<ulint> block(std::min(count(), (ulint) (1 << 16)));
+        for (ulint i = 0; i < count(); i += block.size())
+        {
+            ulint filled = std::min((ulint) block.size(), count() - i);
+            for (ulint j = 0; j < filled; ++j)
+            {
+                block[j] = positions[i + j];
+            }
+            out.write((char *)block.data(), filled * sizeof(ulint));
+        }
+
+        return sizeof(header) + count() * sizeof(ulint);
+    }
+
+    /* load from the istream
+    * \param in the istream
+    */
+    void load(std::istream &in)
+    {
+        ulint header[HEADER_WORDS] = {0};
+        in.read((char *)header, sizeof(ulint));
+
+        // Splittings written before positions were are bit vectors, followed by d if recorded
+        if (header[0] != SPLITS_MAGIC)
+        {
+            in.clear();
+            in.seekg(0);
+
+            sdsl::bit_vector splits;
+            splits.load(in);
+            ulint legacy_d = 0;
+            if (!in.read((char *)&legacy_d, sizeof(legacy_d))) legacy_d = 0;
+
+            *this = split_positions(splits, legacy_d);
+            return;
+        }
+
+        in.read((char *)(header + 1), (HEADER_WORDS - 1) * sizeof(ulint));
+        if (header[1] != SPLITS_VERSION) error("Splitting has version", header[1], "but", SPLITS_VERSION, "is read");
+        n = header[2];
+        d = header[3];
+
+        positions = sdsl::int_vector<>(header[4], 0, bitsize(n));
+        std::vector<ulint> block(std::min(header[4], (ulint) (1 << 16)));
+        for (ulint i = 0; i < header[4]; i += block.size())
+        {
+            ulint filled = std::min((ulint) block.size(), header[4] - i);
+            in.read((char *)block.data(), filled * sizeof(ulint));
+            for (ulint j = 0; j < filled; ++j)
+            {
+                positions[i + j] = block[j];
+            }
+        }
+    }
+
+    std::string get_file_extension() const
+    {
+        return ".d_col";
+    }
+
+private:
+    ulint n = 0; // Length of the BWT
+    ulint d = 0; // Splitting parameter, 0 if unknown
+    sdsl::int_vector<> positions; // Start of each row, in order
+};
+
+#endif /* end of include guard: _SPLIT_POSITIONS_HH */
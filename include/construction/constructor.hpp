@@ -22,6 +22,7 @@
 #define _CONSTRUCTION_HH
 
 #include <common.hpp>
+#include <rlbwt_reader.hpp>
 
 #include <../ds/FL_table.hpp>
 #include <../ds/static_column.hpp>
@@ -55,16 +56,18 @@ public:
         lengths.clear();
         lengths.seekg(0);
 
-        // Mark bits in P and Q to build columns
-        bv_t P_bits = bv_t(table.size(), false);
-        bv_t Q_bits = bv_t(table.size(), false);
+        // Positions of the run heads in P and Q to build columns
+        vector<ulint> P_heads;
+        vector<ulint> Q_heads;
+        P_heads.reserve(table.runs());
+        Q_heads.reserve(table.runs());
         
         char c;
         ulint pos = 0; // Current cursor to run head positions
         vector<vector<size_t>> char_runs = vector<vector<size_t>>(ALPHABET_SIZE); // used to build Q
         while ((c = heads.get()) != EOF)
         {
-            P_bits[pos] = true;
+            P_heads.push_back(pos);
 
             size_t length = 0;
             lengths.read((char *)&length, 5);
@@ -85,13 +88,41 @@ public:
         for (size_t c = 0; c < ALPHABET_SIZE; ++c)
         {
             for (size_t j = 0; j < char_runs[c].size(); ++j) {
-                Q_bits[pos] = true;
+                Q_heads.push_back(pos);
                 pos += char_runs[c][j];
             }
         }
 
-        P = static_column<bv_t>(P_bits);
-        Q = static_column<bv_t>(Q_bits);
+        P = static_column<bv_t>(P_heads, table.size());
+        Q = static_column<bv_t>(Q_heads, table.size());
+    }
+
+    constructor(const rlbwt_reader &rlbwt)
+    {
+        table = FL_table(rlbwt);
+
+        // Positions of the run heads in P and Q to build columns
+        vector<ulint> P_heads;
+        vector<ulint> Q_heads;
+        P_heads.reserve(table.runs());
+        Q_heads.reserve(table.runs());
+
+        ulint pos = 0; // Current cursor to run head positions
+        rlbwt.for_each_run([&](char c, ulint length) {
+            P_heads.push_back(pos);
+            pos += length;
+        });
+
+        // Rows of the FL table are the runs of F in order
+        pos = 0;
+        for (size_t i = 0; i < table.runs(); ++i)
+        {
+            Q_heads.push_back(pos);
+            pos += table.get(i).length;
+        }
+
+        P = static_column<bv_t>(P_heads, table.size());
+        Q = static_column<bv_t>(Q_heads, table.size());
     }
 
     // For a corresponding position in Q, find and return its position in P
@@ -114,7 +145,7 @@ public:
         sdsl::nullstream ns;
 
         verbose("Memory consumption (bytes).");
-        verbose("              FL table:    ", table.serialize(ns));
+        verbose("              FL table:    ", table.serialized_size());
         verbose("              P:           ", P.serialize(ns));
         verbose("              Q:           ", Q.serialize(ns));
     }
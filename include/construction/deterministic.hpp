@@ -22,11 +22,13 @@
 #define _DETERMINISTIC_CONST_HH
 
 #include <common.hpp>
+#include <split_positions.hpp>
 #include <math.h>
 
 #include <../ds/FL_table.hpp>
 #include <../ds/static_column.hpp>
-#include <../ds/index_pq.hpp>
+#include <../ds/bucket_pq.hpp>
+#include <../ds/run_column.hpp>
 
 #include <sdsl/structure_tree.hpp>
 #include <sdsl/util.hpp>
@@ -39,53 +41,55 @@ using namespace sdsl;
 using namespace dyn;
 
 template < class static_bv_t = bit_vector,
-           class dynamic_bv_t = suc_bv >
+           class dynamic_bv_t = run_column >
 class deterministic : public constructor<static_bv_t>
 {
 private:
     dynamic_bv_t init_P_prime;
     dynamic_bv_t init_Q_prime;
-    index_pq init_weights;
+    bucket_pq init_weights; // Weight of each run of Q, by id (runs of F are numbered in order, added runs after)
+    int_vector<> init_run_heads; // Position in Q of the head of each run, by id
 
     void initialize() 
     {
         ulint table_bound = ceil(this->table.runs()*1.5); // at worst, we add r/2 rows
 
-        init_P_prime = dynamic_bv_t();
-        init_Q_prime = dynamic_bv_t();
-        init_weights = index_pq(table_bound, this->table.size()); // at worst, we had r/2 rows
+        init_weights = bucket_pq(table_bound); // at worst, we had r/2 rows
+        init_run_heads = int_vector<>(table_bound, 0, bitsize(uint64_t(this->table.size())));
 
-        ulint total_weight = 0;
-        ulint run_weight = 1;
-        ulint last_run_head = 0;
+        // Run heads of P and Q, so neither column is walked bit by bit
+        vector<ulint> P_heads = vector<ulint>(this->P.bits_set());
+        vector<ulint> Q_heads = vector<ulint>(this->Q.bits_set());
+        for (size_t k = 0; k < P_heads.size(); ++k)
+        {
+            P_heads[k] = this->P.get_idx(k, 0);
+        }
+        for (size_t k = 0; k < Q_heads.size(); ++k)
+        {
+            Q_heads[k] = this->Q.get_idx(k, 0);
+        }
+
+        init_P_prime = dynamic_column(P_heads, this->P.size());
+        init_Q_prime = dynamic_column(Q_heads, this->Q.size());
 
-        init_P_prime.push_back(this->P[0]);
-        init_Q_prime.push_back(this->Q[0]);
-        
         // Initialize the priority queue of weights (number of set bits a run in Q covers in P)
-        // Start at 1 because we know that Q begins with a set bit
-        for (size_t i = 1; i < this->P.size(); ++i)
+        ulint total_weight = 0;
+        ulint next_P_run = 0;
+        for (size_t run = 0; run < Q_heads.size(); ++run)
         {
-            init_P_prime.push_back(this->P[i]);
-            init_Q_prime.push_back(this->Q[i]);
-
-            // 1 denotes start of run, so push the results of prior run
-            if(this->Q[i])
-            {
-                init_weights.push(last_run_head, run_weight);
-                total_weight += run_weight;
+            ulint run_end = (run + 1 < Q_heads.size()) ? Q_heads[run + 1] : this->Q.size();
 
-                run_weight = 0;
-                last_run_head =  i;
-                //last_run++;
-            }
-            if (this->P[i])
+            ulint run_weight = 0;
+            while (next_P_run < P_heads.size() && P_heads[next_P_run] < run_end)
             {
                 ++run_weight;
+                ++next_P_run;
             }
+
+            init_weights.push(run, run_weight);
+            init_run_heads[run] = Q_heads[run];
+            total_weight += run_weight;
         }
-        init_weights.push(last_run_head, run_weight);
-        total_weight += run_weight;
 
         assert(total_weight == this->table.runs());
 
@@ -95,6 +99,31 @@ private:
         #endif
     }
 
+    /*
+     * \param Sorted positions of the set bits
+     * \param Length of the column
+     * \return Dynamic column with those bits set, built from them directly if it holds only its set bits
+     */
+    static dynamic_bv_t dynamic_column(const vector<ulint> &positions, ulint n)
+    {
+        if constexpr (std::is_constructible<dynamic_bv_t, const vector<ulint>&, ulint>::value)
+        {
+            return dynamic_bv_t(positions, n);
+        }
+        else
+        {
+            dynamic_bv_t col;
+            ulint next = 0;
+            for (ulint i = 0; i < n; ++i)
+            {
+                bool set = next < positions.size() && positions[next] == i;
+                col.push_back(set);
+                next += set;
+            }
+            return col;
+        }
+    }
+
 public:
     deterministic() : constructor<static_bv_t>() {}
 
@@ -103,47 +132,70 @@ public:
         initialize();
     }
 
+    deterministic(const rlbwt_reader &rlbwt) : constructor<static_bv_t>(rlbwt)
+    {
+        initialize();
+    }
+
     // Copy from constructor
     deterministic(constructor<static_bv_t>& c) : constructor<static_bv_t>(c) 
     {
         initialize();
     }
 
-    static_bv_t build(ulint d = 2)
+    split_positions build(ulint d = 2)
     {
+        // At most r/(d-1) rows are added, so splitting with d < 2 may not end
+        if (d < 2) error("Splitting parameter must be at least 2, not", d);
+
         dynamic_bv_t P_prime = dynamic_bv_t(init_P_prime);
         dynamic_bv_t Q_prime = dynamic_bv_t(init_Q_prime);
-        index_pq weights = index_pq(init_weights);
+        bucket_pq weights = bucket_pq(init_weights);
+        int_vector<> run_heads = int_vector<>(init_run_heads);
         //weights.extend(this->table.runs()*(1+ceil(1.0/(d-1))));
 
+        // Id of each run of Q, in order
+        packed_spsi run_ids;
+        for (size_t i = 0; i < this->table.runs(); ++i)
+        {
+            run_ids.push_back(i);
+        }
+
         ulint count = 0;
-        auto[max_weight, max_index] = init_weights.get_max();
+        auto[max_weight, max_run] = weights.get_max();
 
         while (max_weight >= 2*d)
         {
+            ulint max_index = run_heads[max_run];
+            ulint new_run = this->table.runs() + count;
+            if (new_run >= init_run_heads.size()) error("Added more rows than the", init_run_heads.size() - this->table.runs(), "bounded for, d =", d);
+
             count++;
             // Find where to set bit (split run)
             ulint first_P_run = P_prime.rank(max_index); // Find first run in P which is covered by Q interval
             ulint Q_insert_position = P_prime.select(first_P_run + d); // Get the position of run bit d positions from first run
             
             // Set bits
-            Q_prime[Q_insert_position] = true;
+            Q_prime.set(Q_insert_position);
             ulint P_insert_position = this->find(Q_insert_position); // Find that corresponding bit in P
-            P_prime[P_insert_position] = true;
+            P_prime.set(P_insert_position);
+
+            // Number the new run of Q
+            run_heads[new_run] = Q_insert_position;
+            run_ids.insert(Q_prime.rank(Q_insert_position), new_run);
 
             // Update PQ for split run in Q
-            weights.demote(max_index, d); // Weight d run of original
-            weights.push(Q_insert_position, max_weight - d); // Rest of original (starting at newly set bit)
+            weights.demote(max_run, d); // Weight d run of original
+            weights.push(new_run, max_weight - d); // Rest of original (starting at newly set bit)
 
             // Update PQ for added bit in P
-            ulint Q_pred_run = Q_prime.rank(P_insert_position + 1) - 1; // Get run
-            ulint Q_pred_idx = Q_prime.select(Q_pred_run); // Get index of set bit
-            weights.promote(Q_pred_idx, weights.get_weight(Q_pred_idx) + 1); // Increment the weight of that run by 1
+            ulint Q_pred_run = run_ids.at(Q_prime.rank(P_insert_position + 1) - 1); // Get run
+            weights.promote(Q_pred_run, weights.get_weight(Q_pred_run) + 1); // Increment the weight of that run by 1
 
             // Take next run of maximum weight
             std::pair<ulint, ulint> max_pair = weights.get_max();
             max_weight = max_pair.first;
-            max_index = max_pair.second;
+            max_run = max_pair.second;
         }
 
         verbose("Added rows: ", count);
@@ -174,13 +226,14 @@ public:
         // }
         //verbose("REAL MAX WEIGHT: ", max_w);
 
-        static_bv_t ret = static_bv_t(P_prime.size());
-        for (size_t i = 0; i < P_prime.size(); ++i)
+        // Only the set bits are visited, as P_prime may be gap encoded, and kept as positions in O(r) words
+        int_vector<> positions = int_vector<>(this->table.runs() + count, 0, bitsize(P_prime.size()));
+        for (size_t k = 0; k < positions.size(); ++k)
         {
-            ret[i] = P_prime[i];
+            positions[k] = P_prime.select(k);
         }
 
-        return ret;
+        return split_positions(P_prime.size(), positions, d);
     }
 
     void stats() {
@@ -191,6 +244,7 @@ public:
         verbose("              P_prime:     ", init_P_prime.serialize(ns));
         verbose("              Q_prime:     ", init_Q_prime.serialize(ns));
         verbose("              Weight-Heap: ", init_weights.serialize(ns));
+        verbose("              Run heads:   ", init_run_heads.serialize(ns));
         verbose("");
 
         auto[max_weight, max_index] = init_weights.get_max();
@@ -213,6 +267,7 @@ public:
         written_bytes += init_P_prime.serialize(out);
         written_bytes += init_Q_prime.serialize(out);
         written_bytes += init_weights.serialize(out, v, "init_weights");
+        written_bytes += init_run_heads.serialize(out, v, "init_run_heads");
 
         return written_bytes;
     }
@@ -224,6 +279,7 @@ public:
         init_P_prime.load(in);
         init_Q_prime.load(in);
         init_weights.load(in);
+        init_run_heads.load(in);
     }
 };
 
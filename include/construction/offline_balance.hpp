@@ -0,0 +1,305 @@
+/* offline_balance - Splits runs in L and F in one sweep of the run boundaries, with a work queue of heavy rows
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file offline_balance.hpp
+   \brief offline_balance.hpp Split runs in L and F to limit LF stepping cost, as deterministic, over linked run boundaries
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#ifndef _OFFLINE_BALANCE_HH
+#define _OFFLINE_BALANCE_HH
+
+#include <common.hpp>
+#include <rlbwt_reader.hpp>
+#include <split_positions.hpp>
+
+#include <sdsl/int_vector.hpp>
+
+// No row, ending the lists of rows
+#define NO_ROW ((ulint) -1)
+
+using namespace std;
+using namespace sdsl;
+
+/*
+ * A row starts at s in L and at q in F, where LF maps [s, s + length) onto [q, q + length). Rows are linked in L
+ * order and in F order, and each row keeps its weight (the heads of L in its range of F), the first of them, and
+ * the row of F covering its own head of L. A heavy row (weight at least 2d) is cut at every d-th head of L in its range
+ * of F, in one walk over them, while at least 2d remain, as deterministic cuts the heaviest row at its d-th head. A
+ * cut at x starts a row at x in F, and at the position mapped to x in L, inside the row cut. Rows are cut in rounds:
+ * every heavy row is cut, then the heads of L the round added are sorted by position (radix sort) and placed in the
+ * rows of F with one merge over them, and the rows they make heavy are cut in the next round. Cutting walks O(d)
+ * heads per cut, and a round takes time linear in the heads it adds and the rows of F they span.
+ */
+class offline_balance
+{
+public:
+    offline_balance() {}
+
+    // Runs of the BWT, mapped
+    offline_balance(const rlbwt_reader &rlbwt)
+    {
+        vector<vector<ulint>> char_rows = vector<vector<ulint>>(ALPHABET_SIZE);
+
+        n = 0;
+        rlbwt.for_each_run([&](char c, ulint length) {
+            if (c <= TERMINATOR) c = TERMINATOR;
+
+            char_rows[(uchar) c].push_back(s.size());
+            s.push_back(n);
+            len.push_back(length);
+            n += length;
+        });
+        r = s.size();
+
+        // Rows of F are the rows of each character in L order, by character
+        q = vector<ulint>(r);
+        vector<ulint> F_order;
+        F_order.reserve(r);
+        ulint F_pos = 0;
+        for (size_t c = 0; c < ALPHABET_SIZE; ++c)
+        {
+            for (ulint row : char_rows[c])
+            {
+                q[row] = F_pos;
+                F_pos += len[row];
+                F_order.push_back(row);
+            }
+            vector<ulint>().swap(char_rows[c]);
+        }
+
+        next_L = vector<ulint>(r);
+        next_F = vector<ulint>(r);
+        for (ulint i = 0; i < r; ++i)
+        {
+            next_L[i] = (i + 1 < r) ? i + 1 : NO_ROW;
+            next_F[F_order[i]] = (i + 1 < r) ? F_order[i + 1] : NO_ROW;
+        }
+
+        // Merge the heads of L into the rows of F
+        weight = vector<ulint>(r, 0);
+        first = vector<ulint>(r, NO_ROW);
+        cover = vector<ulint>(r);
+        ulint F_i = 0;
+        for (ulint i = 0; i < r; ++i)
+        {
+            while (F_i + 1 < r && q[F_order[F_i + 1]] <= s[i]) ++F_i;
+
+            ulint row = F_order[F_i];
+            cover[i] = row;
+            if (weight[row]++ == 0) first[row] = i;
+        }
+
+        #ifdef PRINT_STATS
+        cout << "Text runs: " << r << std::endl;
+        cout << "Text length: " << n << std::endl;
+        cout << "Scan max: " << *std::max_element(weight.begin(), weight.end()) << std::endl;
+        #endif
+    }
+
+    /*
+     * \param Splitting parameter
+     * \return Positions of the heads of the rows of L, in order
+     */
+    split_positions build(ulint d = 2)
+    {
+        // At most r/(d-1) rows are added, so splitting with d < 2 may not end
+        if (d < 2) error("Splitting parameter must be at least 2, not", d);
+
+        // Rows are added to copies, so that the build may be repeated for other d
+        offline_balance split(*this);
+        return split.balance(d);
+    }
+
+private:
+    ulint n = 0; // Length of BWT
+    ulint r = 0; // Runs of BWT
+
+    vector<ulint> s; // Start of each row in L
+    vector<ulint> q; // Start of each row in F
+    vector<ulint> len; // Length of each row
+
+    vector<ulint> next_L; // Next row in L order
+    vector<ulint> next_F; // Next row in F order
+
+    vector<ulint> weight; // Heads of L in the range of F of each row
+    vector<ulint> first; // First row of L starting in the range of F of each row
+    vector<ulint> cover; // Row of F covering the head of L of each row
+
+    split_positions balance(ulint d)
+    {
+        vector<ulint> heavy;
+        vector<bool> queued(r, false);
+        for (ulint i = 0; i < r; ++i)
+        {
+            if (weight[i] >= 2*d)
+            {
+                heavy.push_back(i);
+                queued[i] = true;
+            }
+        }
+
+        vector<ulint> cuts; // Rows cut out of their row of L, not yet linked in L order
+        vector<ulint> added; // Rows added in the round, to place in F
+        while (!heavy.empty())
+        {
+            // Heads are linked in L only once every row is cut, so no walk meets a head not yet counted
+            vector<std::pair<ulint, ulint>> chains; // Row cut, and its rows cut in [begin, end) of cuts
+            for (ulint row : heavy)
+            {
+                queued[row] = false;
+
+                ulint begin = cuts.size();
+                cut(row, d, cuts);
+                chains.push_back(std::make_pair(row, begin));
+            }
+            heavy.clear();
+            queued.resize(s.size(), false);
+
+            ulint start_F = NO_ROW; // Row of F covering a head of L before all those added in the round
+            for (size_t i = 0; i < chains.size(); ++i)
+            {
+                ulint end = (i + 1 < chains.size()) ? chains[i + 1].second : cuts.size();
+                if (chains[i].second == end) continue;
+
+                // Each row cut lies in L after the row it was cut from
+                ulint before = chains[i].first;
+                for (ulint j = chains[i].second; j < end; ++j)
+                {
+                    next_L[cuts[j]] = next_L[before];
+                    next_L[before] = cuts[j];
+                    before = cuts[j];
+                }
+
+                if (start_F == NO_ROW || q[cover[chains[i].first]] < q[start_F]) start_F = cover[chains[i].first];
+            }
+
+            added.swap(cuts);
+            cuts.clear();
+            sort_by_start(added);
+
+            place_heads(added, start_F, d, heavy, queued);
+            added.clear();
+        }
+
+        ulint max_weight = (s.size() > 0) ? *std::max_element(weight.begin(), weight.end()) : 0;
+
+        verbose("Added rows: ", s.size() - r);
+        verbose("Runs after splitting: ", s.size());
+        verbose("Max scan after: ", max_weight);
+
+        #ifdef PRINT_STATS
+        cout << "Runs added: " << s.size() - r << std::endl;
+        cout << "Scan after: " << max_weight << std::endl;
+        #endif
+
+        // Rows in L order are the heads in order, so no bit vector over the BWT is needed
+        int_vector<> positions = int_vector<>(s.size(), 0, bitsize(n));
+        ulint k = 0;
+        for (ulint row = (s.size() > 0) ? 0 : NO_ROW; row != NO_ROW; row = next_L[row])
+        {
+            positions[k++] = s[row];
+        }
+
+        return split_positions(n, positions, d);
+    }
+
+    /*
+     * Cuts a heavy row at every d-th head of L in its range of F while at least 2d remain, moving the heads past each
+     * cut to the new row. Rows cut are appended to cuts, in order, each cut from the one before it (the first from row)
+     */
+    void cut(ulint row, ulint d, vector<ulint> &cuts)
+    {
+        ulint end = q[row] + len[row];
+        ulint head = first[row];
+        ulint remaining = weight[row];
+
+        ulint current = row;
+        while (remaining >= 2*d)
+        {
+            for (ulint i = 0; i < d; ++i)
+            {
+                cover[head] = current;
+                head = next_L[head];
+            }
+            remaining -= d;
+
+            // New row starting at this head in F, and inside the row it is cut from in L
+            ulint x = s[head];
+            ulint added = s.size();
+            s.push_back(s[current] + (x - q[current]));
+            q.push_back(x);
+            len.push_back(end - x);
+            len[current] = x - q[current];
+
+            next_L.push_back(NO_ROW);
+            next_F.push_back(next_F[current]);
+            next_F[current] = added;
+
+            weight[current] = d;
+            weight.push_back(remaining);
+            first.push_back(head);
+            cover.push_back(NO_ROW);
+
+            cuts.push_back(added);
+            current = added;
+        }
+
+        for (ulint i = 0; i < remaining; ++i)
+        {
+            cover[head] = current;
+            head = next_L[head];
+        }
+    }
+
+    // Sorts rows by their start in L, with a radix sort over bytes of the start
+    void sort_by_start(vector<ulint> &rows)
+    {
+        vector<ulint> sorted(rows.size());
+        for (ulint shift = 0; shift < 64 && (n - 1) >> shift > 0; shift += 8)
+        {
+            vector<ulint> counts(256 + 1, 0);
+            for (ulint row : rows) ++counts[((s[row] >> shift) & 0xFF) + 1];
+            for (size_t b = 1; b < counts.size(); ++b) counts[b] += counts[b - 1];
+
+            for (ulint row : rows) sorted[counts[(s[row] >> shift) & 0xFF]++] = row;
+            rows.swap(sorted);
+        }
+    }
+
+    /*
+     * Counts the heads of rows sorted by their start in L in the rows of F covering them, in one merge walking F
+     * from a row before them all. Rows made heavy are queued
+     */
+    void place_heads(const vector<ulint> &rows, ulint row_F, ulint d, vector<ulint> &heavy, vector<bool> &queued)
+    {
+        for (ulint added : rows)
+        {
+            ulint pos = s[added];
+            while (next_F[row_F] != NO_ROW && q[next_F[row_F]] <= pos) row_F = next_F[row_F];
+
+            cover[added] = row_F;
+            if (weight[row_F]++ == 0 || s[first[row_F]] > pos) first[row_F] = added;
+
+            if (weight[row_F] >= 2*d && !queued[row_F])
+            {
+                heavy.push_back(row_F);
+                queued[row_F] = true;
+            }
+        }
+    }
+};
+
+#endif /* end of include guard: _OFFLINE_BALANCE_HH */
@@ -0,0 +1,62 @@
+/* split_LF - Builds the LF table split by deterministic, in a single process
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file split_LF.hpp
+   \brief split_LF.hpp Builds the LF table from the runs, passing the deterministic splitting to it in memory
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#ifndef _SPLIT_LF_HH
+#define _SPLIT_LF_HH
+
+#include <common.hpp>
+#include <rlbwt_reader.hpp>
+#include <constructor.hpp>
+#include <deterministic.hpp>
+#include <offline_balance.hpp>
+#include <../ds/LF_table.hpp>
+
+#include <sdsl/int_vector.hpp>
+#include <sdsl/sd_vector.hpp>
+
+/*
+ * Splits the runs with deterministic (or offline_balance) and builds the LF table of the split runs, without serializing the constructor
+ * or the splitting. The constructor is freed before the table is built, so their memory peaks do not add up.
+ * \param Runs of the BWT, mapped
+ * \param Splitting parameter
+ * \param Threads filling the rows
+ * \param Build in two passes over the runs with rows allocated once
+ * \param Path to also write the splitting to (as run_constructor writes .d_col), empty to not write it
+ */
+template < class splitter_t = deterministic<sdsl::sd_vector<>> >
+LF_table build_split_LF_table(const rlbwt_reader &rlbwt, ulint d, ulint threads = 1, bool low_memory = false, std::string checkpoint = "")
+{
+    split_positions splits;
+    {
+        splitter_t splitter(rlbwt);
+        splits = splitter.build(d);
+    }
+
+    if (!checkpoint.empty())
+    {
+        std::ofstream out(checkpoint);
+        splits.serialize(out);
+        out.close();
+    }
+
+    return LF_table(rlbwt, splits, threads, low_memory);
+}
+
+#endif /* end of include guard: _SPLIT_LF_HH */
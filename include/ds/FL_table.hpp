@@ -23,10 +23,21 @@
 #define _FL_TABLE_HH
 
 #include <common.hpp>
+#include <row_scan.hpp>
+#include <row_io.hpp>
+#include <rlbwt_reader.hpp>
+#include <LF_table.hpp>
+#include <text_samples.hpp>
 
 #include <sdsl/structure_tree.hpp>
 #include <sdsl/util.hpp>
 
+// Serialized tables start with this word, followed by the format version ("FL_table" in little endian)
+#define FL_TABLE_MAGIC 0x656c6261745f4c46ULL
+#define FL_TABLE_VERSION 1 // Rows stored in blocks of columns
+// Words written by serialize before the rows: magic, version, n, r, size
+#define FL_TABLE_HEADER_WORDS 5
+
 using namespace std;
 
 class FL_table
@@ -78,81 +89,74 @@ public:
         heads.seekg(0);
         lengths.clear();
         lengths.seekg(0);
-        
-        vector<char> L_chars = vector<char>();
-        vector<ulint> L_lens = vector<ulint>();
-        vector<vector<ulint>> L_block_indices = vector<vector<ulint>>(ALPHABET_SIZE);
-        vector<vector<ulint>> char_runs = vector<vector<ulint>>(ALPHABET_SIZE); // Vector containing lengths for runs of certain character
-        
-        //ulint max_len = 0;
 
-        char c;
-        n = 0;
-        ulint i = 0;
-        while ((c = heads.get()) != EOF)
-        {
-            size_t length = 0;
-            lengths.read((char *)&length, 5);
-            if (c > TERMINATOR)
-            {
-                L_chars.push_back(c);
-                L_lens.push_back(length);
-                L_block_indices[c].push_back(i++);
-                char_runs[c].push_back(length);
-            }
-            else
+        build([&](auto emit) {
+            char c;
+            while ((c = heads.get()) != EOF)
             {
-                L_chars.push_back(TERMINATOR);
-                L_lens.push_back(length);
-                L_block_indices[TERMINATOR].push_back(i++);
-                char_runs[TERMINATOR].push_back(length);
+                size_t length = 0;
+                lengths.read((char *)&length, 5);
+                emit(c, length);
             }
-            n+=length;
+        });
+    }
 
-            //if (length > max_len) max_len = length;
-        }
-        //cout << "MAX: " << max_len;
-        r = L_chars.size();
+    FL_table(const rlbwt_reader &rlbwt)
+    {
+        build([&](auto emit) { rlbwt.for_each_run(emit); });
+    }
 
-        FL_runs = vector<FL_row>(r);
-        //vector<vector<size_t>> F_block_indices = vector<vector<size_t>>(ALPHABET_SIZE);
-        i = 0;
+    /*
+     * Inverts an LF table (split or not, in memory or mapped), without the runs it was built from. The rows of F
+     * are the images of the rows of L, which keep their order within each character, so they are found by counting
+     * rows per character. FL maps the start of each row of F to the start of its row of L, and starts of rows of L
+     * are found in F by one merge, so building takes O(r + sigma) time. A split table gives the rows of F split
+     * accordingly.
+     * \param LF table
+     */
+    FL_table(LF_table &LF)
+    {
+        n = LF.size();
+        r = LF.runs();
+        d = LF.split_param();
+
+        // Start in F of the rows of each character, becoming the next row of F of that character
+        vector<ulint> F_row(ALPHABET_SIZE + 1, 0);
+        for (size_t i = 0; i < r; ++i)
+        {
+            ++F_row[(uchar) LF.get(i).character + 1];
+        }
         for (size_t c = 0; c < ALPHABET_SIZE; ++c)
         {
-            for (size_t j = 0; j < char_runs[c].size(); ++j) {
-                size_t length = char_runs[c][j];
-                FL_runs[i].character = (unsigned char) c;
-                FL_runs[i].length = length;
-                ++i;
-            }
+            F_row[c + 1] += F_row[c];
         }
 
-        ulint k = 0; // current row to be filled
-        for(size_t i = 0; i < L_block_indices.size(); ++i) 
+        FL_runs = vector<FL_row>(r);
+        vector<ulint> F_index(r); // Row of F of each row of L
+        for (size_t i = 0; i < r; ++i)
         {
-            ulint F_curr = 0; // current position when scanning F
-            ulint F_seen = 0; // characters seen before position in F
-            ulint L_curr = 0; // current position when scanning L
-            ulint L_seen = 0; // characters seen before position in L
-            for(size_t j = 0; j < L_block_indices[i].size(); ++j) 
-            {
-                while (L_curr < L_block_indices[i][j]) {
-                    L_seen += L_lens[L_curr++];
-                }
-                while (F_seen + FL_runs[F_curr].length <= L_seen) {
-                    F_seen += FL_runs[F_curr++].length;
-                }
+            LF_table::LF_row row = LF.get(i);
+            ulint k = F_row[(uchar) row.character]++;
 
-                FL_runs[k].interval = F_curr;
-                FL_runs[k].offset = L_seen - F_seen;
-                ++k;
-            }
+            F_index[i] = k;
+            FL_runs[k].character = row.character;
+            FL_runs[k].length = row.length;
         }
 
-        #ifdef PRINT_STATS
-        cout << "Text runs: " << runs() << std::endl;
-        cout << "Text length: " << size() << std::endl;
-        #endif
+        ulint F_curr = 0; // current row when scanning F
+        ulint F_seen = 0; // characters seen before row in F
+        ulint L_seen = 0; // characters seen before row in L
+        for (size_t i = 0; i < r; ++i)
+        {
+            while (F_seen + FL_runs[F_curr].length <= L_seen) {
+                F_seen += FL_runs[F_curr++].length;
+            }
+
+            FL_runs[F_index[i]].interval = F_curr;
+            FL_runs[F_index[i]].offset = L_seen - F_seen;
+
+            L_seen += FL_runs[F_index[i]].length;
+        }
     }
 
     const FL_row get(size_t i)
@@ -175,8 +179,10 @@ public:
     {
         std::ofstream out(outfile);
 
-        ulint interval = 0;
-        ulint offset = 0;
+        // F starts with the terminator, which is followed by the first character of the text
+        std::pair<ulint, ulint> start = FL(0, 0);
+        ulint interval = start.first;
+        ulint offset = start.second;
 
         char c;
         while((c = get_char(interval)) > TERMINATOR) 
@@ -188,22 +194,76 @@ public:
         }
     }
 
+    /*
+     * Samples every k-th step of the FL walk, which visits the text from first to last character
+     * \param Steps between samples
+     */
+    text_samples sample(ulint period)
+    {
+        return text_samples(*this, period, FL(0, 0), [this](ulint run, ulint offset) { return FL(run, offset); });
+    }
+
+    /*
+     * Extracts text[i, i + len), clipped to the end of the text, walking at most k - 1 + len steps from a sample
+     * \param Text position of the first character
+     * \param Number of characters
+     * \param Samples of the walk, taken from this table by sample()
+     * \return The characters, first to last
+     */
+    std::string extract(ulint i, ulint len, const text_samples &samples)
+    {
+        ulint m = samples.steps();
+        if (i >= m || len == 0) return "";
+        len = std::min(len, m - i);
+
+        ulint k = samples.period();
+        std::pair<ulint, ulint> pos = samples.get(i / k);
+        for (ulint j = i - i % k; j < i; ++j)
+        {
+            pos = FL(pos.first, pos.second);
+        }
+
+        std::string text(len, 0);
+        for (ulint j = 0; j < len; ++j)
+        {
+            text[j] = get_char(pos.first);
+            if (j + 1 < len) pos = FL(pos.first, pos.second);
+        }
+
+        return text;
+    }
+
     /*
      * \param Run position (RLE intervals)
      * \param Current character offset in block
-     * \return block position and offset of preceding character
+     * \return block position and offset of following character
      */
     std::pair<ulint, ulint> FL(ulint run, ulint offset)
     {
         ulint next_interval = FL_runs[run].interval;
 	    ulint next_offset = FL_runs[run].offset + offset;
 
-	    while (next_offset >= FL_runs[next_interval].length) 
+        if (next_offset < FL_runs[next_interval].length)
         {
-            next_offset -= FL_runs[next_interval++].length;
+            return std::make_pair(next_interval, next_offset);
         }
 
-	    return std::make_pair(next_interval, next_offset);
+	    return scan(FL_runs.data(), FL_runs.size(), next_interval, next_offset);
+    }
+
+    // Splitting parameter of the LF table this was built from, 0 if unknown or not split
+    ulint split_param()
+    {
+        return d;
+    }
+
+    /* Choose the kernel used to scan rows, limited to what the CPU supports (default is the best supported).
+     * If specialize is set and the table was built from an LF table split with one of the specialized d, that kernel
+     * is used instead (splitting bounds the rows scanned by LF, not FL, so it falls back to the scalar loop past 2d).
+     */
+    void set_scan(scan_isa isa, bool specialize = false)
+    {
+        scan = select_scan<FL_row>(isa, specialize ? d : 0);
     }
 
     uchar get_char(ulint i)
@@ -235,6 +295,14 @@ public:
         sdsl::structure_tree_node *child = sdsl::structure_tree::add_child(v, name, sdsl::util::class_name(*this));
         size_t written_bytes = 0;
 
+        ulint magic = FL_TABLE_MAGIC;
+        out.write((char *)&magic, sizeof(magic));
+        written_bytes += sizeof(magic);
+
+        ulint version = FL_TABLE_VERSION;
+        out.write((char *)&version, sizeof(version));
+        written_bytes += sizeof(version);
+
         out.write((char *)&n, sizeof(n));
         written_bytes += sizeof(n);
 
@@ -245,37 +313,134 @@ public:
         out.write((char *)&size, sizeof(size));
         written_bytes += sizeof(size);
 
-        for(size_t i = 0; i < size; ++i)
-        {
-            written_bytes += FL_runs[i].serialize(out, v, "FL_run_" + std::to_string(i));
-        }
+        written_bytes += write_rows(out, FL_runs.data(), size);
 
         return written_bytes;
     }
 
+    // Bytes written by serialize, without writing
+    size_t serialized_size() const
+    {
+        return FL_TABLE_HEADER_WORDS * sizeof(ulint) + rows_bytes(FL_runs.size());
+    }
+
     /* load from the istream
     * \param in the istream
     */
     void load(std::istream &in)
     {
         size_t size;
+        ulint magic;
 
-        in.read((char *)&n, sizeof(n));
+        in.read((char *)&magic, sizeof(magic));
+        if (magic == FL_TABLE_MAGIC)
+        {
+            ulint version;
+            in.read((char *)&version, sizeof(version));
+            if (version > FL_TABLE_VERSION) error("FL table version", version, "is newer than supported version", FL_TABLE_VERSION);
+
+            in.read((char *)&n, sizeof(n));
+        }
+        // Tables written before the header start directly with n, and store rows field by field
+        else
+        {
+            n = magic;
+        }
         in.read((char *)&r, sizeof(r));
 
         in.read((char *)&size, sizeof(size));
         FL_runs = std::vector<FL_row>(size);
-        for(size_t i = 0; i < size; ++i)
-        {
-            FL_runs[i].load(in);
-        }
+        if (magic == FL_TABLE_MAGIC) read_rows(in, FL_runs.data(), size);
+        else read_interleaved_rows(in, FL_runs.data(), size);
     }
     
 private:
+    /*
+     * Builds the rows from the runs of L
+     * \param Function calling its argument emit(c, length) for each run of L in order
+     */
+    template < class runs_t >
+    void build(runs_t L_runs)
+    {
+        vector<char> L_chars = vector<char>();
+        vector<ulint> L_lens = vector<ulint>();
+        vector<vector<ulint>> L_block_indices = vector<vector<ulint>>(ALPHABET_SIZE);
+        vector<vector<ulint>> char_runs = vector<vector<ulint>>(ALPHABET_SIZE); // Vector containing lengths for runs of certain character
+        
+        //ulint max_len = 0;
+
+        n = 0;
+        ulint i = 0;
+        L_runs([&](char c, ulint length) {
+            if (c > TERMINATOR)
+            {
+                L_chars.push_back(c);
+                L_lens.push_back(length);
+                L_block_indices[c].push_back(i++);
+                char_runs[c].push_back(length);
+            }
+            else
+            {
+                L_chars.push_back(TERMINATOR);
+                L_lens.push_back(length);
+                L_block_indices[TERMINATOR].push_back(i++);
+                char_runs[TERMINATOR].push_back(length);
+            }
+            n+=length;
+
+            //if (length > max_len) max_len = length;
+        });
+        //cout << "MAX: " << max_len;
+        r = L_chars.size();
+
+        FL_runs = vector<FL_row>(r);
+        //vector<vector<size_t>> F_block_indices = vector<vector<size_t>>(ALPHABET_SIZE);
+        i = 0;
+        for (size_t c = 0; c < ALPHABET_SIZE; ++c)
+        {
+            for (size_t j = 0; j < char_runs[c].size(); ++j) {
+                size_t length = char_runs[c][j];
+                FL_runs[i].character = (unsigned char) c;
+                FL_runs[i].length = length;
+                ++i;
+            }
+        }
+
+        ulint k = 0; // current row to be filled
+        for(size_t i = 0; i < L_block_indices.size(); ++i) 
+        {
+            ulint F_curr = 0; // current position when scanning F
+            ulint F_seen = 0; // characters seen before position in F
+            ulint L_curr = 0; // current position when scanning L
+            ulint L_seen = 0; // characters seen before position in L
+            for(size_t j = 0; j < L_block_indices[i].size(); ++j) 
+            {
+                while (L_curr < L_block_indices[i][j]) {
+                    L_seen += L_lens[L_curr++];
+                }
+                while (F_seen + FL_runs[F_curr].length <= L_seen) {
+                    F_seen += FL_runs[F_curr++].length;
+                }
+
+                FL_runs[k].interval = F_curr;
+                FL_runs[k].offset = L_seen - F_seen;
+                ++k;
+            }
+        }
+
+        #ifdef PRINT_STATS
+        cout << "Text runs: " << runs() << std::endl;
+        cout << "Text length: " << size() << std::endl;
+        #endif
+    }
+
     ulint n; // Length of BWT
     ulint r; // Runs of BWT
+    ulint d = 0; // Splitting parameter of the LF table built from, not serialized
 
     vector<FL_row> FL_runs;
+
+    scan_fn<FL_row> scan = select_scan<FL_row>();
 };
 
 #endif /* end of include guard: _FL_TABLE_HH */
\ No newline at end of file
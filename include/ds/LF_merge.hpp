@@ -0,0 +1,210 @@
+/* LF_merge - Merges the BWTs of two LF tables, adding texts to a collection
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file LF_merge.hpp
+   \brief LF_merge.hpp Merges the BWTs of two LF tables into the runs of the BWT of their collection, interleaving them with LF walks
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#ifndef _LF_MERGE_HH
+#define _LF_MERGE_HH
+
+#include <common.hpp>
+#include <LF_table.hpp>
+
+#include <algorithm>
+
+using namespace std;
+
+/*
+ * Interleaves the suffixes of the texts of B among those of A, where A and B are each the table of a text or a
+ * collection. Terminators of A sort before those of B, so the texts of B follow those of A in the collection. Each
+ * text of B is walked backwards from its terminator with the LF of B, and each suffix cS of B is placed after
+ * C_A[c] + rank_c(L_A, p) suffixes of A, where p suffixes of A are smaller than S. Ranks are found by binary search
+ * over the rows of each character of A, so interleaving takes O(n_B log r_A) time and O(n_B + r_A) words. The
+ * merged runs are then emitted in one pass over the rows of A and the positions of B.
+ */
+class LF_merge
+{
+public:
+    /*
+     * \param Table of the collection, split or not
+     * \param Table of the texts added, split or not
+     */
+    LF_merge(LF_table &A, LF_table &B) : A(A), B(B)
+    {
+        index_A();
+        interleave();
+    }
+
+    // Length of the merged BWT
+    ulint size() const
+    {
+        return A_start.back() + B_start.back();
+    }
+
+    /*
+     * Calls emit(c, length) for every run of the merged BWT in order
+     * \return Number of runs
+     */
+    template < class emit_t >
+    ulint for_each_run(emit_t emit)
+    {
+        ulint runs = 0;
+        char last_c = 0;
+        ulint length = 0;
+        auto push = [&](char c, ulint count) {
+            if (length != 0 && c == last_c)
+            {
+                length += count;
+                return;
+            }
+
+            if (length != 0)
+            {
+                emit(last_c, length);
+                ++runs;
+            }
+            last_c = c;
+            length = count;
+        };
+
+        // Cursor on the rows of A, emitting positions of A up to (not including) position end
+        ulint A_row = 0;
+        ulint A_pos = 0;
+        auto emit_A = [&](ulint end) {
+            while (A_pos < end)
+            {
+                ulint take = std::min(end, A_start[A_row + 1]) - A_pos;
+                push(A.get_char(A_row), take);
+
+                A_pos += take;
+                if (A_pos == A_start[A_row + 1]) ++A_row;
+            }
+        };
+
+        ulint B_row = 0;
+        for (ulint q = 0; q < B_start.back(); ++q)
+        {
+            while (q >= B_start[B_row + 1]) ++B_row;
+
+            emit_A(inserted[q]);
+            push(B.get_char(B_row), 1);
+        }
+        emit_A(A_start.back());
+
+        if (length != 0)
+        {
+            emit(last_c, length);
+            ++runs;
+        }
+
+        return runs;
+    }
+
+    /*
+     * Writes the merged BWT as heads and lengths, to build and split its tables as for any RLBWT
+     * \param Path of the BWT, writing bwt_fname.heads and bwt_fname.len
+     * \return Number of runs
+     */
+    ulint write(std::string bwt_fname)
+    {
+        return write_rlbwt(bwt_fname, [&](auto emit) { return for_each_run(emit); });
+    }
+
+private:
+    // Starts of the rows of A and B, and for each character the rows of A holding it
+    void index_A()
+    {
+        A_start = vector<ulint>(A.runs() + 1, 0);
+        for (ulint i = 0; i < A.runs(); ++i)
+        {
+            LF_table::LF_row row = A.get(i);
+            A_start[i + 1] = A_start[i] + row.length;
+            A_rows[(uchar) row.character].push_back(i);
+            C[(uchar) row.character + 1] += row.length;
+        }
+        for (size_t c = 0; c < ALPHABET_SIZE; ++c)
+        {
+            C[c + 1] += C[c];
+        }
+
+        B_start = vector<ulint>(B.runs() + 1, 0);
+        for (ulint i = 0; i < B.runs(); ++i)
+        {
+            LF_table::LF_row row = B.get(i);
+            B_start[i + 1] = B_start[i] + row.length;
+            if (row.character == TERMINATOR) B_terminators += row.length;
+        }
+    }
+
+    // Number of suffixes of A smaller than cS, given p suffixes of A are smaller than S
+    ulint step_A(uchar c, ulint p)
+    {
+        const vector<ulint> &rows = A_rows[c];
+
+        // Last row of c starting before p
+        vector<ulint>::const_iterator it = std::partition_point(rows.begin(), rows.end(), [&](ulint row) { return A_start[row] < p; });
+        if (it == rows.begin()) return C[c];
+
+        LF_table::LF_row row = A.get(*(it - 1));
+        ulint F_pos = A_start[row.interval] + row.offset;
+
+        return F_pos + std::min(p - A_start[*(it - 1)], row.length);
+    }
+
+    void interleave()
+    {
+        ulint n_B = B_start.back();
+        inserted = vector<ulint>(n_B);
+
+        // Texts of B end at its terminators, rows 0 to k_B - 1 of F, sorting after the terminators of A and before any
+        // other suffix of A. Each text is walked back to its first character, whose row in L holds a terminator, as LF
+        // would carry on into another text.
+        ulint steps = 0;
+        for (ulint j = 0; j < B_terminators; ++j)
+        {
+            ulint p = C[TERMINATOR + 1];
+            ulint row = std::upper_bound(B_start.begin(), B_start.end(), j) - B_start.begin() - 1;
+            std::pair<ulint, ulint> pos = std::make_pair(row, j - B_start[row]);
+            while (true)
+            {
+                inserted[B_start[pos.first] + pos.second] = p;
+                ++steps;
+
+                uchar c = B.get_char(pos.first);
+                if (c == TERMINATOR) break;
+
+                p = step_A(c, p);
+                pos = B.LF(pos.first, pos.second);
+            }
+        }
+
+        if (steps != n_B) error("The texts of the table added cover", steps, "of its", n_B, "positions");
+    }
+
+    LF_table &A;
+    LF_table &B;
+
+    vector<ulint> A_start; // Start of each row of A, and the length of A
+    vector<ulint> B_start; // Start of each row of B, and the length of B
+    ulint B_terminators = 0; // Number of texts of B
+    vector<vector<ulint>> A_rows = vector<vector<ulint>>(ALPHABET_SIZE); // Rows of A of each character, in order
+    vector<ulint> C = vector<ulint>(ALPHABET_SIZE + 1, 0); // Positions of A with a smaller character
+
+    vector<ulint> inserted; // For each position of B, the number of positions of A before it in the merged BWT
+};
+
+#endif /* end of include guard: _LF_MERGE_HH */
@@ -24,11 +24,38 @@
 
 #include "sdsl/int_vector.hpp"
 #include <algorithm>
+#include <memory>
+#include <thread>
+#include <tuple>
 #include <common.hpp>
+#include <mapped_file.hpp>
+#include <rlbwt_reader.hpp>
+#include <bwt_reader.hpp>
+#include <block_writer.hpp>
+#include <block_reader.hpp>
+#include <split_positions.hpp>
+#include <parallel.hpp>
+#include <row_scan.hpp>
+#include <row_io.hpp>
+#include <text_samples.hpp>
 
 #include <sdsl/structure_tree.hpp>
 #include <sdsl/util.hpp>
 
+// Serialized tables start with this word, followed by the format version ("LF_table" in little endian)
+#define LF_TABLE_MAGIC 0x656c6261745f464cULL
+#define LF_TABLE_ROW_VERSION 1 // Stream layout, rows stored field by field (read only)
+#define LF_TABLE_MAPPED_VERSION 2 // Mapped layout, rows stored in memory layout after an aligned header
+#define LF_TABLE_VERSION 3 // Stream layout, rows stored in blocks of columns
+// Words written by serialize before the rows: magic, version, n, r, d, size
+#define LF_TABLE_HEADER_WORDS 6
+// Rows per task of a parallel build
+#define BUILD_CHUNK (1 << 16)
+// Characters buffered by each thread of an inversion before writing, twice for double buffering
+#define INVERT_BLOCK (1 << 22)
+// Fewest values buffered by each stream of an external build, however small the budget
+#define EXTERNAL_MIN_BLOCK (1 << 12)
+
 using namespace std;
 
 class LF_table
@@ -42,7 +69,7 @@ public:
         ulint interval;
         ulint offset;
 
-        size_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, std::string name ="")
+        size_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, std::string name ="") const
         {
             sdsl::structure_tree_node *child = sdsl::structure_tree::add_child(v, name, sdsl::util::class_name(*this));
             size_t written_bytes = 0;
@@ -71,242 +98,300 @@ public:
         }
     };
 
+    // Header of the mapped layout, one cache line so that the rows following it are aligned
+    struct LF_header
+    {
+        ulint magic;
+        ulint version;
+        ulint n;
+        ulint r;
+        ulint d;
+        ulint size; // Number of rows
+        ulint row_bytes; // sizeof(LF_row) of the writer
+        ulint rows_offset; // Bytes from start of file to first row
+    };
+
     LF_table() {}
 
-    LF_table(std::ifstream &heads, std::ifstream &lengths, ulint max_run = 0)
+    LF_table(const LF_table &other) : n(other.n), r(other.r), d(other.d), LF_runs(other.LF_runs), mapping(other.mapping), scan(other.scan)
     {
-        heads.clear();
-        heads.seekg(0);
-        lengths.clear();
-        lengths.seekg(0);
-        
-        LF_runs = vector<LF_row>();
-        vector<vector<size_t>> L_block_indices = vector<vector<size_t>>(ALPHABET_SIZE);
-        
-        char c;
-        ulint i = 0;
-        r = 0;
-        n = 0;
-        while ((c = heads.get()) != EOF)
-        {
-            size_t length = 0;
-            lengths.read((char *)&length, 5);
-            if (c <= TERMINATOR) c = TERMINATOR;
+        rows = mapping ? other.rows : LF_runs.data();
+    }
 
-            if (max_run > 0 && length > max_run) {
-                ulint max_splits = length/max_run;
-                for (size_t split = 0; split < max_splits; ++split)
-                {
-                    LF_runs.push_back({c, max_run, 0, 0});
-                    L_block_indices[c].push_back(i++);
-                }
+    // Moving the vector keeps its buffer, so rows stays valid
+    LF_table(LF_table &&other) = default;
 
-                if (length % max_run != 0)
-                {
-                    LF_runs.push_back({c, length % max_run, 0, 0});
-                    L_block_indices[c].push_back(i++);
-                }
-            }
-            else {
-                LF_runs.push_back({c, length, 0, 0});
-                L_block_indices[c].push_back(i++);
-            }    
-            n+=length;
-        }
-        r = LF_runs.size();
+    LF_table &operator=(LF_table other)
+    {
+        std::swap(n, other.n);
+        std::swap(r, other.r);
+        std::swap(d, other.d);
+        std::swap(LF_runs, other.LF_runs);
+        std::swap(rows, other.rows);
+        std::swap(mapping, other.mapping);
+        std::swap(scan, other.scan);
+        return *this;
+    }
 
-        ulint curr_L_num = 0;
-        ulint L_seen = 0;
-        ulint F_seen = 0;
-        for(size_t i = 0; i < L_block_indices.size(); ++i) 
-        {
-            for(size_t j = 0; j < L_block_indices[i].size(); ++j) 
-            {
-                ulint pos = L_block_indices[i][j];
+    /*
+     * \param Heads of the BWT runs
+     * \param Lengths of the BWT runs (5 bytes each)
+     * \param Longest row, longer runs are cut (0 to keep runs whole)
+     * \param Threads filling the rows
+     * \param Build in two passes over the runs with rows allocated once, without index vectors (single threaded)
+     */
+    LF_table(std::ifstream &heads, std::ifstream &lengths, ulint max_run = 0, ulint threads = 1, bool low_memory = false)
+    {
+        auto runs = [&](auto emit) { return read_runs(heads, lengths, max_run, emit); };
+        if (low_memory) build_in_place(runs);
+        else build(runs, threads);
 
-                LF_runs[pos].interval = curr_L_num;
-                LF_runs[pos].offset = F_seen - L_seen;
+        rows = LF_runs.data();
+        mem_stats();
+    }
 
-                F_seen += LF_runs[pos].length;
-            
-                while (curr_L_num < r && F_seen >= L_seen + LF_runs[curr_L_num].length) 
-                {
-                    L_seen += LF_runs[curr_L_num].length;
-                    ++curr_L_num;
-                }
-            }
-        }
+    /*
+     * \param Runs of the BWT, mapped
+     * \param Longest row, longer runs are cut (0 to keep runs whole)
+     * \param Threads filling the rows
+     * \param Build in two passes over the runs with rows allocated once, without index vectors (single threaded)
+     */
+    LF_table(const rlbwt_reader &rlbwt, ulint max_run = 0, ulint threads = 1, bool low_memory = false)
+    {
+        auto runs = [&](auto emit) { return read_runs(rlbwt, max_run, emit); };
+        if (low_memory) build_in_place(runs);
+        else build(runs, threads);
 
+        rows = LF_runs.data();
         mem_stats();
     }
 
-    LF_table(std::ifstream &bwt, ulint max_run = 0)
+    /*
+     * \param Plain BWT, mapped and searched for runs in parallel chunks
+     * \param Longest row, longer runs are cut (0 to keep runs whole)
+     * \param Threads filling the rows
+     * \param Build in two passes over the runs with rows allocated once, without index vectors (single threaded)
+     */
+    LF_table(const bwt_reader &bwt, ulint max_run = 0, ulint threads = 1, bool low_memory = false)
     {
-        bwt.clear();
-        bwt.seekg(0);
-        
-        LF_runs = vector<LF_row>();
-        vector<vector<size_t>> L_block_indices = vector<vector<size_t>>(ALPHABET_SIZE);
-        
-        char last_c;
-        char c;
-        ulint i = 0;
-        r = 0;
-        n = 0;
-        size_t length = 0;
-        while ((c = bwt.get()) != EOF)
-        {
-            if (c <= TERMINATOR) c = TERMINATOR;
-            
-            if (i != 0 && c != last_c)
-            {
-                if (max_run > 0 && length > max_run) {
-                    ulint max_splits = length/max_run;
-                    for (size_t split = 0; split < max_splits; ++split)
-                    {
-                        LF_runs.push_back({last_c, max_run, 0, 0});
-                        L_block_indices[last_c].push_back(i++);
-                    }
+        auto runs = [&](auto emit) { return read_runs(bwt, max_run, emit); };
+        if (low_memory) build_in_place(runs);
+        else build(runs, threads);
 
-                    if (length % max_run != 0)
-                    {
-                        LF_runs.push_back({last_c, length % max_run, 0, 0});
-                        L_block_indices[last_c].push_back(i++);
-                    }
-                }
-                else {
-                    LF_runs.push_back({last_c, length, 0, 0});
-                    L_block_indices[last_c].push_back(i++);
-                }    
-                n+=length;
-                length = 0;
-            }
-            ++length;
-            last_c = c;
-        }
-        // Step for final character
-        if (max_run > 0 && length > max_run) {
-            ulint max_splits = length/max_run;
-            for (size_t split = 0; split < max_splits; ++split)
-            {
-                LF_runs.push_back({last_c, max_run, 0, 0});
-                L_block_indices[last_c].push_back(i++);
-            }
+        rows = LF_runs.data();
+        mem_stats();
+    }
 
-            if (length % max_run != 0)
-            {
-                LF_runs.push_back({last_c, length % max_run, 0, 0});
-                L_block_indices[last_c].push_back(i++);
-            }
-        }
-        else {
-            LF_runs.push_back({last_c, length, 0, 0});
-            L_block_indices[last_c].push_back(i++);
-        }    
-        n+=length;
+    LF_table(std::ifstream &bwt, ulint max_run = 0, ulint threads = 1, bool low_memory = false)
+    {
+        auto runs = [&](auto emit) { return read_runs(bwt, max_run, emit); };
+        if (low_memory) build_in_place(runs);
+        else build(runs, threads);
 
-        r = LF_runs.size();
+        rows = LF_runs.data();
+        mem_stats();
+    }
 
-        ulint curr_L_num = 0;
-        ulint L_seen = 0;
-        ulint F_seen = 0;
-        for(size_t i = 0; i < L_block_indices.size(); ++i) 
-        {
-            for(size_t j = 0; j < L_block_indices[i].size(); ++j) 
-            {
-                ulint pos = L_block_indices[i][j];
+    LF_table(std::ifstream &heads, std::ifstream &lengths, const sdsl::bit_vector &splits, ulint d = 0, ulint threads = 1, bool low_memory = false)
+    {
+        this->d = d;
 
-                LF_runs[pos].interval = curr_L_num;
-                LF_runs[pos].offset = F_seen - L_seen;
+        ulint bv_r = sdsl::util::cnt_one_bits(splits);
 
-                F_seen += LF_runs[pos].length;
-            
-                while (curr_L_num < r && F_seen >= L_seen + LF_runs[curr_L_num].length) 
-                {
-                    L_seen += LF_runs[curr_L_num].length;
-                    ++curr_L_num;
-                }
-            }
-        }
+        auto runs = [&](auto emit) { return read_runs(heads, lengths, splits, emit); };
+        ulint true_r = low_memory ? build_in_place(runs) : build(runs, threads);
 
+        cout << "True r: " << true_r << endl;
+        cout << "BV r: " << bv_r << endl;
+        rows = LF_runs.data();
+        set_scan(detect_scan_isa());
         mem_stats();
     }
 
-    LF_table(std::ifstream &heads, std::ifstream &lengths, sdsl::bit_vector splits)
+    LF_table(const rlbwt_reader &rlbwt, const sdsl::bit_vector &splits, ulint d = 0, ulint threads = 1, bool low_memory = false)
     {
-        heads.clear();
-        heads.seekg(0);
-        lengths.clear();
-        lengths.seekg(0);
+        this->d = d;
 
-        LF_runs = vector<LF_row>();
-        vector<vector<size_t>> L_block_indices = vector<vector<size_t>>(ALPHABET_SIZE);
+        ulint bv_r = sdsl::util::cnt_one_bits(splits);
 
-        char c;
-        ulint i = 0;
-        r = 0;
-        ulint bv_r = 0;
-        ulint true_r = 0;
-        for (size_t i = 0; i < splits.size(); ++i) {
-            bv_r += splits[i];
-        }
-        n = 0;
-        while ((c = heads.get()) != EOF)
-        {
-            size_t length = 0;
-            lengths.read((char *)&length, 5);
-            n+=length;
-            true_r += 1;
-            if (c <= TERMINATOR) c = TERMINATOR;
+        auto runs = [&](auto emit) { return read_runs(rlbwt, splits, emit); };
+        ulint true_r = low_memory ? build_in_place(runs) : build(runs, threads);
 
-            size_t curr_len = 1; // Assume we start at a run-head
-            for (size_t bwt_i = n - length + 1; bwt_i < n; bwt_i++)
-            {
-                if (splits[bwt_i]) 
-                {
-                    LF_runs.push_back({c, curr_len, 0, 0});
-                    L_block_indices[c].push_back(i++);
-                    curr_len = 0;
-                }
-                curr_len++;
-            }
-            LF_runs.push_back({c, curr_len, 0, 0});
-            L_block_indices[c].push_back(i++);
+        cout << "True r: " << true_r << endl;
+        cout << "BV r: " << bv_r << endl;
+        rows = LF_runs.data();
+        set_scan(detect_scan_isa());
+        mem_stats();
+    }
 
-        }
-        r = LF_runs.size();
+    LF_table(const bwt_reader &bwt, const sdsl::bit_vector &splits, ulint d = 0, ulint threads = 1, bool low_memory = false)
+    {
+        this->d = d;
 
-        ulint curr_L_num = 0;
-        ulint L_seen = 0;
-        ulint F_seen = 0;
-        for(size_t i = 0; i < L_block_indices.size(); ++i) 
-        {
-            for(size_t j = 0; j < L_block_indices[i].size(); ++j) 
-            {
-                ulint pos = L_block_indices[i][j];
+        ulint bv_r = sdsl::util::cnt_one_bits(splits);
 
-                LF_runs[pos].interval = curr_L_num;
-                LF_runs[pos].offset = F_seen - L_seen;
+        auto runs = [&](auto emit) { return read_runs(bwt, splits, emit); };
+        ulint true_r = low_memory ? build_in_place(runs) : build(runs, threads);
 
-                F_seen += LF_runs[pos].length;
+        cout << "True r: " << true_r << endl;
+        cout << "BV r: " << bv_r << endl;
+        rows = LF_runs.data();
+        set_scan(detect_scan_isa());
+        mem_stats();
+    }
 
-                while (curr_L_num < r && F_seen >= L_seen + LF_runs[curr_L_num].length) 
-                {
-                    L_seen += LF_runs[curr_L_num].length;
-                    ++curr_L_num;
-                }
-            }
-        }
+    /*
+     * \param Runs of the BWT, mapped
+     * \param Positions the rows start at, the splitting parameter recorded with them
+     * \param Threads filling the rows
+     * \param Build in two passes over the runs with rows allocated once, without index vectors (single threaded)
+     */
+    LF_table(const rlbwt_reader &rlbwt, const split_positions &splits, ulint threads = 1, bool low_memory = false)
+    {
+        d = splits.split_param();
+
+        auto runs = [&](auto emit) {
+            auto cursor = splits.cursor();
+            return read_runs(rlbwt, cursor, emit);
+        };
+        ulint true_r = low_memory ? build_in_place(runs) : build(runs, threads);
 
         cout << "True r: " << true_r << endl;
-        cout << "BV r: " << bv_r << endl;
+        cout << "BV r: " << splits.count() << endl;
+        rows = LF_runs.data();
+        set_scan(detect_scan_isa());
+        mem_stats();
+    }
+
+    LF_table(const bwt_reader &bwt, const split_positions &splits, ulint threads = 1, bool low_memory = false)
+    {
+        d = splits.split_param();
+
+        auto runs = [&](auto emit) {
+            auto cursor = splits.cursor();
+            return read_runs(bwt, cursor, emit);
+        };
+        ulint true_r = low_memory ? build_in_place(runs) : build(runs, threads);
+
+        cout << "True r: " << true_r << endl;
+        cout << "BV r: " << splits.count() << endl;
+        rows = LF_runs.data();
+        set_scan(detect_scan_isa());
         mem_stats();
     }
 
+    /*
+     * Builds the table of rows kept as they are, already split (as by dynamic_LF_table)
+     * \param Function calling its argument emit(c, length) for each row in L order, returning the number of rows
+     * \param Splitting parameter of the rows (0 if unknown or not split)
+     * \param Threads filling the rows
+     */
+    template < class runs_t >
+    static LF_table from_rows(runs_t runs, ulint d = 0, ulint threads = 1)
+    {
+        LF_table table;
+        table.d = d;
+        table.build(runs, threads);
+
+        table.rows = table.LF_runs.data();
+        table.set_scan(detect_scan_isa());
+        table.mem_stats();
+        return table;
+    }
+
+    /*
+     * Builds the table of the runs straight to a file, in the layout of serialize (or serialize_mapped), without
+     * holding its rows in memory. Lengths of the rows are written to a temporary file next to the output, and each
+     * character streams through the rows of L its rows map to, which are disjoint ranges of that file, so all I/O
+     * is sequential. Memory is the budget plus O(sigma).
+     * \param Runs of the BWT, mapped (rlbwt_reader or bwt_reader)
+     * \param Path of the table
+     * \param Bytes buffered by the streams of the build
+     * \param Write the mapped layout
+     * \param Longest row, longer runs are cut (0 to keep runs whole)
+     * \return Number of BWT runs
+     */
+    template < class reader_t >
+    static ulint build_external(const reader_t &reader, std::string outfile, ulint budget, bool mapped = false, ulint max_run = 0)
+    {
+        auto runs = [&](auto emit) { return read_runs(reader, max_run, emit); };
+
+        std::ofstream out(outfile);
+        ulint bwt_runs = write_external(runs, out, outfile + ".lengths", 0, budget, mapped);
+        out.close();
+
+        return bwt_runs;
+    }
+
+    // Splitting held in memory, as positions
+    template < class reader_t >
+    static ulint build_external(const reader_t &reader, const split_positions &splits, std::string outfile, ulint budget, bool mapped = false)
+    {
+        auto runs = [&](auto emit) {
+            auto cursor = splits.cursor();
+            return read_runs(reader, cursor, emit);
+        };
+
+        std::ofstream out(outfile);
+        ulint true_r = write_external(runs, out, outfile + ".lengths", splits.split_param(), budget, mapped);
+        out.close();
+
+        cout << "True r: " << true_r << endl;
+        cout << "BV r: " << splits.count() << endl;
+
+        return true_r;
+    }
+
+    /*
+     * Splitting streamed from a .d_col, its positions read in order through a buffer of a quarter of the budget, so
+     * neither the splitting nor the rows are held in memory
+     * \return Number of BWT runs
+     */
+    template < class reader_t >
+    static ulint build_external(const reader_t &reader, std::string splits_fname, std::string outfile, ulint budget, bool mapped = false)
+    {
+        ulint header[split_positions::HEADER_WORDS];
+        int fd = split_positions::open_positions(splits_fname, header);
+        verbose("Splitting built with d =", header[3]);
+
+        ulint block = std::max((ulint) EXTERNAL_MIN_BLOCK, budget / (4 * sizeof(ulint)));
+        auto runs = [&](auto emit) {
+            auto cursor = split_positions::file_cursor(fd, header, block);
+            return read_runs(reader, cursor, emit);
+        };
+
+        std::ofstream out(outfile);
+        ulint true_r = write_external(runs, out, outfile + ".lengths", header[3], budget - std::min(budget, block * sizeof(ulint)), mapped);
+        out.close();
+        close(fd);
+
+        cout << "True r: " << true_r << endl;
+        cout << "BV r: " << header[4] << endl;
+
+        return true_r;
+    }
+
+    template < class reader_t >
+    static ulint build_external(const reader_t &reader, const sdsl::bit_vector &splits, ulint d, std::string outfile, ulint budget, bool mapped = false)
+    {
+        ulint bv_r = sdsl::util::cnt_one_bits(splits);
+
+        auto runs = [&](auto emit) { return read_runs(reader, splits, emit); };
+
+        std::ofstream out(outfile);
+        ulint true_r = write_external(runs, out, outfile + ".lengths", d, budget, mapped);
+        out.close();
+
+        cout << "True r: " << true_r << endl;
+        cout << "BV r: " << bv_r << endl;
+
+        return true_r;
+    }
+
     const LF_row get(size_t i)
     {
-        assert(i < LF_runs.size());
-        return LF_runs[i];
+        assert(i < r);
+        return rows[i];
     }
 
     ulint size()
@@ -337,101 +422,1074 @@ public:
     }
 
     /*
-     * \param Run position (RLE intervals)
-     * \param Current character offset in block
-     * \return block position and offset of preceding character
+     * Inverts in one pass, writing the text first character first. The walk fills blocks back to front, and each
+     * block is written at its final position while the next one is filled. The text is that written by invert, the
+     * characters walked before the first terminator.
+     * \param Output file
      */
-    std::pair<ulint, ulint> LF(ulint run, ulint offset)
+    void invert_forward(std::string outfile)
     {
-        ulint next_interval = LF_runs[run].interval;
-        ulint next_offset = LF_runs[run].offset + offset;
+        ulint m = text_length();
+        int fd = open_inverted(outfile, m);
 
-        while (next_offset >= LF_runs[next_interval].length) 
-        {
-            next_offset -= LF_runs[next_interval++].length;
-        }
-
-        return std::make_pair(next_interval, next_offset);
-    }
+        if (m > 0) invert_range(fd, 0, 0, 0, m, m, true);
 
-    uchar get_char(ulint i)
-    {
-        return get(i).character;
+        close(fd);
     }
 
-    std::string get_file_extension() const
+    /*
+     * Steps walked from the first row before reaching a terminator, as invert and text_samples stop. With a single
+     * terminator the walk visits every other position first, otherwise (a collection) the steps are counted.
+     * \return Length of the text inverted
+     */
+    ulint text_length()
     {
-        return ".LF_table";
-    }
+        if (n <= 1) return 0;
 
-    void mem_stats()
-    {
-        sdsl::nullstream ns;
+        ulint terminators = 0;
+        for (size_t i = 0; i < r; ++i)
+        {
+            if (get_char(i) <= TERMINATOR) terminators += rows[i].length;
+        }
+        if (terminators == 1) return n - 1;
 
-        verbose("Memory consumption (bytes).");
-        verbose("              LF table: ", serialize(ns));
-    }
+        ulint m = 0;
+        ulint interval = 0;
+        ulint offset = 0;
+        while (get_char(interval) > TERMINATOR)
+        {
+            std::pair<ulint, ulint> pos = LF(interval, offset);
+            interval = pos.first;
+            offset = pos.second;
+            ++m;
+        }
 
-    void bwt_stats()
-    {
-        ulint n = size();
-        ulint r = runs();
-        verbose("Number of BWT equal-letter runs: r = ", r);
-        verbose("Length of complete BWT: n = ", n);
-        verbose("Rate n/r = ", double(n) / r);
-        verbose("log2(r) = ", log2(double(r)));
-        verbose("log2(n/r) = ", log2(double(n) / r));
+        return m;
     }
 
-    /* serialize to the ostream
-    * \param out     the ostream
-    */
-    size_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, std::string name ="")
+    /*
+     * Inverts in parallel. Threads walk consecutive ranges of samples, each writing its characters into its slice
+     * of the preallocated file.
+     * \param Output file
+     * \param Samples of the walk, taken from this table
+     * \param Number of threads
+     * \param Write the text first character first, otherwise the same file as invert
+     */
+    void invert(std::string outfile, const text_samples &samples, ulint threads, bool forward = false)
     {
-        sdsl::structure_tree_node *child = sdsl::structure_tree::add_child(v, name, sdsl::util::class_name(*this));
-        size_t written_bytes = 0;
-
-        out.write((char *)&n, sizeof(n));
-        written_bytes += sizeof(n);
+        int fd = open_inverted(outfile, samples.steps());
 
-        out.write((char *)&r, sizeof(r));
-        written_bytes += sizeof(r);
+        ulint count = samples.size();
+        threads = std::max((ulint) 1, std::min(threads, count));
 
-        size_t size = LF_runs.size();
-        out.write((char *)&size, sizeof(size));
-        written_bytes += sizeof(size);
+        vector<std::thread> workers;
+        for (ulint t = 0; t < threads; ++t)
+        {
+            ulint first = count * t / threads;
+            ulint last = count * (t + 1) / threads;
+            ulint step = first * samples.period();
+            ulint end = std::min(last * samples.period(), samples.steps());
+            if (step >= end) continue;
+
+            std::pair<ulint, ulint> start = samples.get(first);
+            workers.emplace_back([this, fd, start, step, end, &samples, forward]() {
+                invert_range(fd, start.first, start.second, step, end, samples.steps(), forward);
+            });
+        }
 
-        for(size_t i = 0; i < size; ++i)
+        for (std::thread &worker : workers)
         {
-            written_bytes += LF_runs[i].serialize(out, v, "LF_run_" + std::to_string(i));
+            worker.join();
         }
 
-        return written_bytes;
+        close(fd);
     }
 
-    /* load from the istream
-    * \param in the istream
-    */
-    void load(std::istream &in)
+    /*
+     * Extracts text[i, i + len), clipped to the end of the text, walking at most k - 1 + len steps from a sample
+     * \param Text position of the first character
+     * \param Number of characters
+     * \param Samples of the walk, taken from this table
+     * \return The characters, first to last
+     */
+    std::string extract(ulint i, ulint len, const text_samples &samples)
+    {
+        ulint m = samples.steps();
+        if (i >= m || len == 0) return "";
+        len = std::min(len, m - i);
+
+        // The walk visits the text backwards, so start at the step of the last character
+        ulint step = m - i - len;
+        ulint k = samples.period();
+        std::pair<ulint, ulint> pos = samples.get(step / k);
+        for (ulint j = step - step % k; j < step; ++j)
+        {
+            pos = LF(pos.first, pos.second);
+        }
+
+        std::string text(len, 0);
+        for (ulint j = len; j > 0; --j)
+        {
+            text[j - 1] = get_char(pos.first);
+            if (j > 1) pos = LF(pos.first, pos.second);
+        }
+
+        return text;
+    }
+
+    /*
+     * \param Run position (RLE intervals)
+     * \param Current character offset in block
+     * \return block position and offset of preceding character
+     */
+    std::pair<ulint, ulint> LF(ulint run, ulint offset)
+    {
+        ulint next_interval = rows[run].interval;
+        ulint next_offset = rows[run].offset + offset;
+
+        if (next_offset < rows[next_interval].length)
+        {
+            return std::make_pair(next_interval, next_offset);
+        }
+
+        return scan(rows, r, next_interval, next_offset);
+    }
+
+    /*
+     * First half of LF, split so that callers can overlap the memory access of the destination row
+     * \param Run position (RLE intervals)
+     * \param Current character offset in block
+     * \return unscanned destination interval and offset, whose row has been prefetched
+     */
+    inline std::pair<ulint, ulint> LF_prefetch(ulint run, ulint offset)
+    {
+        const LF_row &row = rows[run];
+        prefetch(row.interval);
+
+        return std::make_pair(row.interval, row.offset + offset);
+    }
+
+    /*
+     * Second half of LF, scanning from the destination given by LF_prefetch
+     * \param Destination interval
+     * \param Offset from start of destination interval
+     * \return block position and offset of preceding character
+     */
+    inline std::pair<ulint, ulint> LF_scan(ulint interval, ulint offset)
+    {
+        if (offset < rows[interval].length)
+        {
+            return std::make_pair(interval, offset);
+        }
+
+        return scan(rows, r, interval, offset);
+    }
+
+    inline void prefetch(ulint run)
+    {
+        __builtin_prefetch(&rows[run]);
+    }
+
+    /*
+     * Advances every position by one LF step, in place. Positions are processed in groups, where the
+     * source rows of group g+2 and the destination rows of group g+1 are prefetched while group g is finished.
+     * \param Positions (run, offset) of independent walks
+     * \param Number of positions
+     * \param Positions per group
+     */
+    void LF_batch(std::pair<ulint, ulint> *positions, size_t count, size_t group = 16)
+    {
+        if (count == 0) return;
+        if (group == 0) group = 1;
+
+        // Prefetch source rows of the first two groups, and read them for the first group
+        for (size_t i = 0; i < std::min(count, 2*group); ++i)
+        {
+            prefetch(positions[i].first);
+        }
+        for (size_t i = 0; i < std::min(count, group); ++i)
+        {
+            positions[i] = LF_prefetch(positions[i].first, positions[i].second);
+        }
+
+        for (size_t start = 0; start < count; start += group)
+        {
+            size_t end = std::min(count, start + group);
+            size_t next_end = std::min(count, end + group);
+            size_t ahead_end = std::min(count, next_end + group);
+
+            // Group g+2: prefetch source rows
+            for (size_t i = next_end; i < ahead_end; ++i)
+            {
+                prefetch(positions[i].first);
+            }
+            // Group g+1: read source rows, prefetch destination rows
+            for (size_t i = end; i < next_end; ++i)
+            {
+                positions[i] = LF_prefetch(positions[i].first, positions[i].second);
+            }
+            // Group g: scan from destination rows
+            for (size_t i = start; i < end; ++i)
+            {
+                positions[i] = LF_scan(positions[i].first, positions[i].second);
+            }
+        }
+    }
+
+    void LF_batch(std::vector<std::pair<ulint, ulint>> &positions, size_t group = 16)
+    {
+        LF_batch(positions.data(), positions.size(), group);
+    }
+
+    // Splitting parameter the table was built with, 0 if unknown or not split
+    ulint split_param()
+    {
+        return d;
+    }
+
+    /* Choose the kernel used to scan rows, limited to what the CPU supports (default is the best supported).
+     * If specialize is set and the table was split with one of the specialized d, that kernel is used instead
+     * (opt-in, as it can lose to the vector scan when steps wait on memory; compare with bench_LF).
+     */
+    void set_scan(scan_isa isa, bool specialize = false)
+    {
+        scan = select_scan<LF_row>(isa, specialize ? d : 0);
+    }
+
+    uchar get_char(ulint i)
+    {
+        return get(i).character;
+    }
+
+    std::string get_file_extension() const
+    {
+        return ".LF_table";
+    }
+
+    std::string get_mapped_file_extension() const
+    {
+        return ".mapped_LF_table";
+    }
+
+    // True if rows are read in place from a mapped file
+    bool is_mapped()
+    {
+        return (bool) mapping;
+    }
+
+    void mem_stats()
+    {
+        verbose("Memory consumption (bytes).");
+        verbose("              LF table: ", serialized_size());
+    }
+
+    void bwt_stats()
+    {
+        ulint n = size();
+        ulint r = runs();
+        verbose("Number of BWT equal-letter runs: r = ", r);
+        verbose("Length of complete BWT: n = ", n);
+        verbose("Rate n/r = ", double(n) / r);
+        verbose("log2(r) = ", log2(double(r)));
+        verbose("log2(n/r) = ", log2(double(n) / r));
+    }
+
+    /* serialize to the ostream
+    * \param out     the ostream
+    */
+    size_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, std::string name ="")
+    {
+        sdsl::structure_tree_node *child = sdsl::structure_tree::add_child(v, name, sdsl::util::class_name(*this));
+        size_t written_bytes = 0;
+
+        ulint magic = LF_TABLE_MAGIC;
+        out.write((char *)&magic, sizeof(magic));
+        written_bytes += sizeof(magic);
+
+        ulint version = LF_TABLE_VERSION;
+        out.write((char *)&version, sizeof(version));
+        written_bytes += sizeof(version);
+
+        out.write((char *)&n, sizeof(n));
+        written_bytes += sizeof(n);
+
+        out.write((char *)&r, sizeof(r));
+        written_bytes += sizeof(r);
+
+        out.write((char *)&d, sizeof(d));
+        written_bytes += sizeof(d);
+
+        size_t size = r;
+        out.write((char *)&size, sizeof(size));
+        written_bytes += sizeof(size);
+
+        written_bytes += write_rows(out, rows, size);
+
+        return written_bytes;
+    }
+
+    // Bytes written by serialize, without writing
+    size_t serialized_size() const
+    {
+        return LF_TABLE_HEADER_WORDS * sizeof(ulint) + rows_bytes(r);
+    }
+
+    /* serialize to the ostream in the mapped layout, which map() can query in place. The stream must be at
+    * the start of a file for the rows to be aligned.
+    * \param out     the ostream
+    */
+    size_t serialize_mapped(std::ostream &out)
+    {
+        size_t written_bytes = 0;
+
+        LF_header header = {LF_TABLE_MAGIC, LF_TABLE_MAPPED_VERSION, n, r, d, r, sizeof(LF_row), sizeof(LF_header)};
+        out.write((char *)&header, sizeof(header));
+        written_bytes += sizeof(header);
+
+        // Copy through a zeroed buffer, so padding bytes of the rows are written deterministically
+        const size_t chunk = 1 << 16;
+        vector<LF_row> buffer(std::min((size_t) r, chunk));
+        for (size_t start = 0; start < r; start += chunk)
+        {
+            size_t count = std::min((size_t) r - start, chunk);
+            memset((void *) buffer.data(), 0, count * sizeof(LF_row));
+            for (size_t i = 0; i < count; ++i)
+            {
+                buffer[i].character = rows[start + i].character;
+                buffer[i].length = rows[start + i].length;
+                buffer[i].interval = rows[start + i].interval;
+                buffer[i].offset = rows[start + i].offset;
+            }
+
+            out.write((char *)buffer.data(), count * sizeof(LF_row));
+            written_bytes += count * sizeof(LF_row);
+        }
+
+        return written_bytes;
+    }
+
+    /* map a file written by serialize_mapped, reading rows in place (read-only). The mapping is shared
+    * with copies of the table, and between processes mapping the same file through the page cache.
+    * \param fname    the file
+    * \param populate read the whole file when mapping, instead of on first access
+    */
+    void map(std::string fname, bool populate = false)
+    {
+        std::shared_ptr<mapped_file> file = std::make_shared<mapped_file>(fname, populate);
+
+        if (file->size() < sizeof(LF_header)) error("File too small for a mapped LF table:", fname);
+
+        LF_header header;
+        memcpy(&header, file->data(), sizeof(header));
+
+        if (header.magic != LF_TABLE_MAGIC) error("Not an LF table:", fname);
+        if (header.version != LF_TABLE_MAPPED_VERSION) error("LF table version", header.version, "cannot be mapped:", fname);
+        if (header.row_bytes != sizeof(LF_row)) error("LF table rows of", header.row_bytes, "bytes cannot be mapped, expected", sizeof(LF_row));
+        if (header.rows_offset % alignof(LF_row) != 0 || header.rows_offset + header.size * header.row_bytes > file->size())
+        {
+            error("Corrupt mapped LF table:", fname);
+        }
+
+        n = header.n;
+        r = header.size;
+        d = header.d;
+
+        LF_runs = vector<LF_row>();
+        mapping = file;
+        rows = (const LF_row *) (file->data() + header.rows_offset);
+
+        set_scan(detect_scan_isa());
+    }
+
+    /* load from the istream
+    * \param in the istream
+    */
+    void load(std::istream &in)
     {
         size_t size;
+        ulint magic;
+        bool interleaved = true;
+
+        in.read((char *)&magic, sizeof(magic));
+        if (magic == LF_TABLE_MAGIC)
+        {
+            ulint version;
+            in.read((char *)&version, sizeof(version));
+            if (version > LF_TABLE_VERSION) error("LF table version", version, "is newer than supported version", LF_TABLE_VERSION);
+
+            // The mapped layout can also be read into memory
+            if (version == LF_TABLE_MAPPED_VERSION)
+            {
+                LF_header header;
+                in.read((char *)&header.n, sizeof(header) - 2*sizeof(ulint));
+                if (header.row_bytes != sizeof(LF_row)) error("LF table rows of", header.row_bytes, "bytes cannot be read, expected", sizeof(LF_row));
+
+                in.ignore(header.rows_offset - sizeof(header));
+
+                n = header.n;
+                r = header.size;
+                d = header.d;
+
+                mapping.reset();
+                LF_runs = std::vector<LF_row>(r);
+                in.read((char *)LF_runs.data(), r * sizeof(LF_row));
+                rows = LF_runs.data();
 
-        in.read((char *)&n, sizeof(n));
-        in.read((char *)&r, sizeof(r));
+                set_scan(detect_scan_isa());
+                return;
+            }
+
+            in.read((char *)&n, sizeof(n));
+            in.read((char *)&r, sizeof(r));
+            in.read((char *)&d, sizeof(d));
+            interleaved = (version == LF_TABLE_ROW_VERSION);
+        }
+        // Tables written before the header start directly with n, and did not record d
+        else
+        {
+            n = magic;
+            in.read((char *)&r, sizeof(r));
+            d = 0;
+        }
 
         in.read((char *)&size, sizeof(size));
+        mapping.reset();
         LF_runs = std::vector<LF_row>(size);
-        for(size_t i = 0; i < size; ++i)
+        if (interleaved) read_interleaved_rows(in, LF_runs.data(), size);
+        else read_rows(in, LF_runs.data(), size);
+        rows = LF_runs.data();
+
+        set_scan(detect_scan_isa());
+    }
+
+private:
+    // Calls emit(c, length) for each row of a run, cutting it into rows of max_run if longer (and max_run is not 0)
+    template < class emit_t >
+    static void emit_run(char c, ulint length, ulint max_run, emit_t &emit)
+    {
+        if (max_run > 0 && length > max_run) {
+            ulint max_splits = length/max_run;
+            for (size_t split = 0; split < max_splits; ++split)
+            {
+                emit(c, max_run);
+            }
+
+            if (length % max_run != 0)
+            {
+                emit(c, length % max_run);
+            }
+        }
+        else {
+            emit(c, length);
+        }
+    }
+
+    /*
+     * Reads the runs of heads/lengths, calling emit(c, length) for each row in L order
+     * \return Number of BWT runs
+     */
+    template < class emit_t >
+    static ulint read_runs(std::ifstream &heads, std::ifstream &lengths, ulint max_run, emit_t emit)
+    {
+        heads.clear();
+        heads.seekg(0);
+        lengths.clear();
+        lengths.seekg(0);
+
+        ulint bwt_runs = 0;
+        char c;
+        while ((c = heads.get()) != EOF)
         {
-            LF_runs[i].load(in);
+            size_t length = 0;
+            lengths.read((char *)&length, 5);
+            if (c <= TERMINATOR) c = TERMINATOR;
+
+            emit_run(c, length, max_run, emit);
+            ++bwt_runs;
         }
+
+        return bwt_runs;
     }
 
-private:
-    ulint n; // Length of BWT
-    ulint r; // Runs of BWT
+    /*
+     * Reads the mapped runs, calling emit(c, length) for each row in L order
+     * \return Number of BWT runs
+     */
+    template < class emit_t >
+    static ulint read_runs(const rlbwt_reader &rlbwt, ulint max_run, emit_t emit)
+    {
+        rlbwt.for_each_run([&](char c, ulint length) {
+            if (c <= TERMINATOR) c = TERMINATOR;
+            emit_run(c, length, max_run, emit);
+        });
+
+        return rlbwt.runs();
+    }
+
+    /*
+     * Reads the runs of the mapped BWT, calling emit(c, length) for each row in L order
+     * \return Number of BWT runs
+     */
+    template < class emit_t >
+    static ulint read_runs(const bwt_reader &bwt, ulint max_run, emit_t emit)
+    {
+        return bwt.for_each_run([&](char c, ulint length) {
+            emit_run(c, length, max_run, emit);
+        });
+    }
+
+    /*
+     * Reads the runs of the BWT, calling emit(c, length) for each row in L order
+     * \return Number of BWT runs
+     */
+    template < class emit_t >
+    static ulint read_runs(std::ifstream &bwt, ulint max_run, emit_t emit)
+    {
+        bwt.clear();
+        bwt.seekg(0);
+
+        ulint bwt_runs = 0;
+        char last_c = 0;
+        char c;
+        size_t length = 0;
+        while ((c = bwt.get()) != EOF)
+        {
+            if (c <= TERMINATOR) c = TERMINATOR;
+
+            if (length != 0 && c != last_c)
+            {
+                emit_run(last_c, length, max_run, emit);
+                ++bwt_runs;
+                length = 0;
+            }
+            ++length;
+            last_c = c;
+        }
+        // Step for final character
+        if (length != 0)
+        {
+            emit_run(last_c, length, max_run, emit);
+            ++bwt_runs;
+        }
+
+        return bwt_runs;
+    }
+
+    // A splitting has a bit per BWT position, so one built for another BWT (or a stale one) is rejected
+    static void check_splits(const sdsl::bit_vector &splits, ulint n)
+    {
+        if (splits.size() != n) error("Splitting has", splits.size(), "positions, but the BWT has", n);
+    }
+
+    template < class source_t >
+    static void check_splits(const split_cursor<source_t> &splits, ulint n)
+    {
+        if (splits.size() != n) error("Splitting is of a BWT of length", splits.size(), "but the BWT has", n);
+    }
+
+    // First row start of the splitting in [from, to), or to if there is none
+    static ulint next_split(const sdsl::bit_vector &splits, ulint from, ulint to)
+    {
+        return next_set_bit(splits, from, to);
+    }
+
+    template < class source_t >
+    static ulint next_split(split_cursor<source_t> &splits, ulint from, ulint to)
+    {
+        return splits.next(from, to);
+    }
+
+    // Calls emit(c, length) for each row of the run ending before n, cut at each later row start of the splitting
+    template < class splits_t, class emit_t >
+    static void emit_split_run(char c, ulint length, ulint n, splits_t &splits, emit_t &emit)
+    {
+        // Assume we start at a run-head, and cut at each later row start of the run
+        ulint row_start = n - length;
+        ulint bwt_i = row_start + 1;
+        while ((bwt_i = next_split(splits, bwt_i, n)) < n)
+        {
+            emit(c, bwt_i - row_start);
+            row_start = bwt_i++;
+        }
+        emit(c, n - row_start);
+    }
+
+    /*
+     * Reads the runs of heads/lengths, calling emit(c, length) for each row in L order, cutting runs at the set bits
+     * of splits (a bit per BWT position, set where a row starts). Set bits are found a word at a time, so a run costs
+     * its rows plus its length / 64.
+     * \return Number of BWT runs
+     */
+    template < class emit_t >
+    static ulint read_runs(std::ifstream &heads, std::ifstream &lengths, const sdsl::bit_vector &splits, emit_t emit)
+    {
+        heads.clear();
+        heads.seekg(0);
+        lengths.clear();
+        lengths.seekg(0);
+
+        ulint bwt_runs = 0;
+        ulint n = 0;
+        char c;
+        while ((c = heads.get()) != EOF)
+        {
+            size_t length = 0;
+            lengths.read((char *)&length, 5);
+            n+=length;
+            bwt_runs += 1;
+            if (c <= TERMINATOR) c = TERMINATOR;
+
+            emit_split_run(c, length, n, splits, emit);
+        }
+        check_splits(splits, n);
+
+        return bwt_runs;
+    }
+
+    /*
+     * Reads the mapped runs, calling emit(c, length) for each row in L order, cutting runs at the row starts of
+     * splits (a bit vector, or a cursor over positions)
+     * \return Number of BWT runs
+     */
+    template < class splits_t, class emit_t >
+    static ulint read_split_runs(const rlbwt_reader &rlbwt, splits_t &splits, emit_t emit)
+    {
+        ulint n = 0;
+        rlbwt.for_each_run([&](char c, ulint length) {
+            n += length;
+            if (c <= TERMINATOR) c = TERMINATOR;
+
+            emit_split_run(c, length, n, splits, emit);
+        });
+        check_splits(splits, n);
+
+        return rlbwt.runs();
+    }
+
+    /*
+     * Reads the runs of the mapped BWT, calling emit(c, length) for each row in L order, cutting runs at the row
+     * starts of splits (a bit vector, or a cursor over positions)
+     * \return Number of BWT runs
+     */
+    template < class splits_t, class emit_t >
+    static ulint read_split_runs(const bwt_reader &bwt, splits_t &splits, emit_t emit)
+    {
+        check_splits(splits, bwt.size());
+
+        ulint n = 0;
+        return bwt.for_each_run([&](char c, ulint length) {
+            n += length;
+            emit_split_run(c, length, n, splits, emit);
+        });
+    }
+
+    template < class emit_t >
+    static ulint read_runs(const rlbwt_reader &rlbwt, const sdsl::bit_vector &splits, emit_t emit)
+    {
+        return read_split_runs(rlbwt, splits, emit);
+    }
+
+    template < class emit_t >
+    static ulint read_runs(const bwt_reader &bwt, const sdsl::bit_vector &splits, emit_t emit)
+    {
+        return read_split_runs(bwt, splits, emit);
+    }
+
+    // Row starts read in order from positions, held or streamed, so the splitting takes no n-bit vector
+    template < class source_t, class emit_t >
+    static ulint read_runs(const rlbwt_reader &rlbwt, split_cursor<source_t> &splits, emit_t emit)
+    {
+        return read_split_runs(rlbwt, splits, emit);
+    }
+
+    template < class source_t, class emit_t >
+    static ulint read_runs(const bwt_reader &bwt, split_cursor<source_t> &splits, emit_t emit)
+    {
+        return read_split_runs(bwt, splits, emit);
+    }
+
+    /*
+     * Builds the rows given by runs, listing the rows of each character to fill them
+     * \param Function calling its argument emit(c, length) for each row in L order, returning the number of BWT runs
+     * \param Threads filling the rows
+     * \return Number of BWT runs
+     */
+    template < class runs_t >
+    ulint build(runs_t runs, ulint threads)
+    {
+        LF_runs = vector<LF_row>();
+        vector<vector<size_t>> L_block_indices = vector<vector<size_t>>(ALPHABET_SIZE);
+
+        n = 0;
+        ulint bwt_runs = runs([&](char c, ulint length) {
+            L_block_indices[(uchar) c].push_back(LF_runs.size());
+            LF_runs.push_back({c, length, 0, 0});
+            n += length;
+        });
+        r = LF_runs.size();
+
+        fill_rows(L_block_indices, threads);
+
+        return bwt_runs;
+    }
+
+    /*
+     * Builds the rows given by runs in two passes. The first counts rows and the length of each character, so rows
+     * are allocated once at their final size and the start of each character in F is known. The second stores
+     * the rows, which are then filled in L order, keeping for each character its next position in F and the run of L
+     * holding it. Besides the rows, memory is O(sigma).
+     * \param Function calling its argument emit(c, length) for each row in L order, returning the number of BWT runs
+     * \return Number of BWT runs
+     */
+    template < class runs_t >
+    ulint build_in_place(runs_t runs)
+    {
+        vector<ulint> F_start(ALPHABET_SIZE + 1, 0);
+        r = 0;
+        runs([&](char c, ulint length) {
+            F_start[(uchar) c + 1] += length;
+            ++r;
+        });
+        for (size_t c = 0; c < ALPHABET_SIZE; ++c)
+        {
+            F_start[c + 1] += F_start[c];
+        }
+        n = F_start[ALPHABET_SIZE];
+
+        LF_runs = vector<LF_row>(r);
+        ulint i = 0;
+        ulint bwt_runs = runs([&](char c, ulint length) {
+            LF_runs[i++] = {c, length, 0, 0};
+        });
+
+        // Run of L holding the first position in F of each character, and its start
+        vector<ulint> curr_L_num(ALPHABET_SIZE);
+        vector<ulint> L_seen(ALPHABET_SIZE);
+        ulint j = 0;
+        ulint seen = 0;
+        for (size_t c = 0; c < ALPHABET_SIZE; ++c)
+        {
+            while (j < r && seen + LF_runs[j].length <= F_start[c])
+            {
+                seen += LF_runs[j++].length;
+            }
+            curr_L_num[c] = j;
+            L_seen[c] = seen;
+        }
+
+        // F_start of each character becomes the position in F of its next row
+        for (i = 0; i < r; ++i)
+        {
+            uchar c = LF_runs[i].character;
+
+            LF_runs[i].interval = curr_L_num[c];
+            LF_runs[i].offset = F_start[c] - L_seen[c];
+
+            F_start[c] += LF_runs[i].length;
+
+            while (curr_L_num[c] < r && F_start[c] >= L_seen[c] + LF_runs[curr_L_num[c]].length)
+            {
+                L_seen[c] += LF_runs[curr_L_num[c]].length;
+                ++curr_L_num[c];
+            }
+        }
+
+        return bwt_runs;
+    }
+
+    /*
+     * Writes the table of the rows given by runs to out in two passes, as build_in_place but with the rows on disk.
+     * The first counts rows and the length of each character, writing the length of each row to tmp_fname. Each
+     * character then gets a cursor on the run of L holding its first position in F, reading the following lengths
+     * from its own block_reader. The second pass writes the rows in L order, a block at a time, advancing the cursor
+     * of the character of each row.
+     * \return Number of BWT runs
+     */
+    template < class runs_t >
+    static ulint write_external(runs_t runs, std::ostream &out, std::string tmp_fname, ulint d, ulint budget, bool mapped)
+    {
+        int fd = open(tmp_fname.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (fd < 0) error("Cannot open", tmp_fname, ":", strerror(errno));
+        // Removed from the directory now, and from disk once closed
+        unlink(tmp_fname.c_str());
+
+        vector<ulint> F_start(ALPHABET_SIZE + 1, 0);
+        ulint r = 0;
+        {
+            // Two buffers, each of half the budget
+            ulint block = std::max((ulint) EXTERNAL_MIN_BLOCK, budget / (2 * sizeof(ulint)));
+            block_writer writer(fd, block * sizeof(ulint));
+            ulint filled = 0;
+
+            runs([&](char c, ulint length) {
+                F_start[(uchar) c + 1] += length;
+                ((ulint *) writer.data())[filled++] = length;
+                ++r;
+
+                if (filled == block)
+                {
+                    writer.flush(0, filled * sizeof(ulint), (r - filled) * sizeof(ulint));
+                    filled = 0;
+                }
+            });
+            if (filled) writer.flush(0, filled * sizeof(ulint), (r - filled) * sizeof(ulint));
+        }
+        for (size_t c = 0; c < ALPHABET_SIZE; ++c)
+        {
+            F_start[c + 1] += F_start[c];
+        }
+        ulint n = F_start[ALPHABET_SIZE];
+
+        ulint sigma = 0;
+        for (size_t c = 0; c < ALPHABET_SIZE; ++c)
+        {
+            if (F_start[c + 1] > F_start[c]) ++sigma;
+        }
+        // A buffer per character, plus the rows being written
+        ulint block = std::max((ulint) EXTERNAL_MIN_BLOCK, budget / ((sigma + 1) * sizeof(ulint)));
+
+        // Run of L holding the first position in F of each character, its start and its length
+        vector<ulint> curr_L_num(ALPHABET_SIZE);
+        vector<ulint> L_seen(ALPHABET_SIZE);
+        vector<ulint> L_length(ALPHABET_SIZE);
+        {
+            block_reader<ulint> lengths(fd, 0, block);
+            ulint j = 0;
+            ulint seen = 0;
+            ulint length = (r > 0) ? lengths.next() : 0;
+            for (size_t c = 0; c < ALPHABET_SIZE; ++c)
+            {
+                while (j < r && seen + length <= F_start[c])
+                {
+                    seen += length;
+                    if (++j < r) length = lengths.next();
+                }
+                curr_L_num[c] = j;
+                L_seen[c] = seen;
+                L_length[c] = length;
+            }
+        }
+
+        vector<std::unique_ptr<block_reader<ulint>>> cursors(ALPHABET_SIZE);
+        for (size_t c = 0; c < ALPHABET_SIZE; ++c)
+        {
+            if (F_start[c + 1] > F_start[c]) cursors[c] = std::make_unique<block_reader<ulint>>(fd, curr_L_num[c] + 1, block);
+        }
+
+        if (mapped)
+        {
+            LF_header header = {LF_TABLE_MAGIC, LF_TABLE_MAPPED_VERSION, n, r, d, r, sizeof(LF_row), sizeof(LF_header)};
+            out.write((char *)&header, sizeof(header));
+        }
+        else
+        {
+            ulint header[LF_TABLE_HEADER_WORDS] = {LF_TABLE_MAGIC, LF_TABLE_VERSION, n, r, d, r};
+            out.write((char *)header, sizeof(header));
+        }
+
+        // Zeroed, so padding bytes of mapped rows are written deterministically
+        vector<LF_row> block_rows(std::min(r, (ulint) ROW_IO_BLOCK));
+        ulint filled = 0;
+        auto write_block = [&]() {
+            if (mapped) out.write((char *)block_rows.data(), filled * sizeof(LF_row));
+            else write_rows(out, block_rows.data(), filled);
+            filled = 0;
+        };
+
+        // F_start of each character becomes the position in F of its next row
+        ulint bwt_runs = runs([&](char c, ulint length) {
+            uchar u = c;
+
+            LF_row &row = block_rows[filled++];
+            row.character = c;
+            row.length = length;
+            row.interval = curr_L_num[u];
+            row.offset = F_start[u] - L_seen[u];
+
+            F_start[u] += length;
+
+            while (curr_L_num[u] < r && F_start[u] >= L_seen[u] + L_length[u])
+            {
+                L_seen[u] += L_length[u];
+                if (++curr_L_num[u] < r) L_length[u] = cursors[u]->next();
+            }
+
+            if (filled == block_rows.size()) write_block();
+        });
+        if (filled) write_block();
+
+        close(fd);
+
+        return bwt_runs;
+    }
+
+    /*
+     * Sets interval and offset of every row from the lengths. Rows of each character are visited in L order, as
+     * listed by L_block_indices, and are mapped to the run of L holding their first position in F. With more than
+     * one thread, the rows of each character are cut into chunks, whose start in F is a prefix sum over chunks and
+     * whose first run of L is found by binary search, so that chunks are filled independently.
+     */
+    void fill_rows(const vector<vector<size_t>> &L_block_indices, ulint threads)
+    {
+        if (threads <= 1)
+        {
+            ulint curr_L_num = 0;
+            ulint L_seen = 0;
+            ulint F_seen = 0;
+            for(size_t i = 0; i < L_block_indices.size(); ++i) 
+            {
+                for(size_t j = 0; j < L_block_indices[i].size(); ++j) 
+                {
+                    ulint pos = L_block_indices[i][j];
+
+                    LF_runs[pos].interval = curr_L_num;
+                    LF_runs[pos].offset = F_seen - L_seen;
+
+                    F_seen += LF_runs[pos].length;
+                
+                    while (curr_L_num < r && F_seen >= L_seen + LF_runs[curr_L_num].length) 
+                    {
+                        L_seen += LF_runs[curr_L_num].length;
+                        ++curr_L_num;
+                    }
+                }
+            }
+            return;
+        }
+
+        // Start of each run in L, summing chunks of runs in parallel and then within each chunk from its base
+        vector<ulint> L_start(r + 1, 0);
+        ulint L_chunks = (r + BUILD_CHUNK - 1) / BUILD_CHUNK;
+        vector<ulint> L_base(L_chunks + 1, 0);
+        parallel_for(L_chunks, threads, [&](ulint t) {
+            for (ulint i = t * BUILD_CHUNK; i < std::min(r, (t + 1) * BUILD_CHUNK); ++i)
+            {
+                L_base[t + 1] += LF_runs[i].length;
+            }
+        });
+        for (ulint t = 0; t < L_chunks; ++t)
+        {
+            L_base[t + 1] += L_base[t];
+        }
+        parallel_for(L_chunks, threads, [&](ulint t) {
+            ulint L_seen = L_base[t];
+            for (ulint i = t * BUILD_CHUNK; i < std::min(r, (t + 1) * BUILD_CHUNK); ++i)
+            {
+                L_start[i] = L_seen;
+                L_seen += LF_runs[i].length;
+            }
+        });
+        L_start[r] = L_base[L_chunks];
+
+        // Chunks of the rows of each character, in F order: (character, first, last)
+        vector<std::tuple<size_t, size_t, size_t>> chunks;
+        for (size_t c = 0; c < L_block_indices.size(); ++c)
+        {
+            for (size_t j = 0; j < L_block_indices[c].size(); j += BUILD_CHUNK)
+            {
+                chunks.emplace_back(c, j, std::min(L_block_indices[c].size(), j + BUILD_CHUNK));
+            }
+        }
+
+        // Start of each chunk in F
+        vector<ulint> F_base(chunks.size() + 1, 0);
+        parallel_for(chunks.size(), threads, [&](ulint t) {
+            auto [c, first, last] = chunks[t];
+            for (size_t j = first; j < last; ++j)
+            {
+                F_base[t + 1] += LF_runs[L_block_indices[c][j]].length;
+            }
+        });
+        for (size_t t = 0; t < chunks.size(); ++t)
+        {
+            F_base[t + 1] += F_base[t];
+        }
+
+        parallel_for(chunks.size(), threads, [&](ulint t) {
+            auto [c, first, last] = chunks[t];
+            ulint F_seen = F_base[t];
+            ulint curr_L_num = std::upper_bound(L_start.begin(), L_start.begin() + r, F_seen) - L_start.begin() - 1;
+
+            for (size_t j = first; j < last; ++j)
+            {
+                ulint pos = L_block_indices[c][j];
+
+                LF_runs[pos].interval = curr_L_num;
+                LF_runs[pos].offset = F_seen - L_start[curr_L_num];
+
+                F_seen += LF_runs[pos].length;
+
+                while (curr_L_num + 1 < r && F_seen >= L_start[curr_L_num + 1])
+                {
+                    ++curr_L_num;
+                }
+            }
+        });
+    }
+
+    // Creates the output of an inversion, allocated to m characters
+    int open_inverted(std::string outfile, ulint m)
+    {
+        int fd = open(outfile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) error("Cannot open", outfile, ":", strerror(errno));
+        if (ftruncate(fd, m) != 0) error("Cannot allocate", outfile, ":", strerror(errno));
+
+        return fd;
+    }
+
+    /*
+     * Walks steps [step, end) of the inversion from (interval, offset). Step j is written at byte j of the file,
+     * or at byte m-1-j if forward, filling each block back to front.
+     */
+    void invert_range(int fd, ulint interval, ulint offset, ulint step, ulint end, ulint m, bool forward)
+    {
+        block_writer writer(fd, std::min((ulint) INVERT_BLOCK, end - step));
+        ulint capacity = writer.block_size();
+
+        while (step < end)
+        {
+            ulint block = std::min(capacity, end - step);
+            char *buffer = writer.data();
+
+            if (forward)
+            {
+                for (ulint i = capacity; i > capacity - block; --i)
+                {
+                    buffer[i - 1] = get_char(interval);
+                    std::pair<ulint, ulint> pos = LF(interval, offset);
+                    interval = pos.first;
+                    offset = pos.second;
+                }
+
+                writer.flush(capacity - block, block, m - step - block);
+            }
+            else
+            {
+                for (ulint i = 0; i < block; ++i)
+                {
+                    buffer[i] = get_char(interval);
+                    std::pair<ulint, ulint> pos = LF(interval, offset);
+                    interval = pos.first;
+                    offset = pos.second;
+                }
+
+                writer.flush(0, block, step);
+            }
+
+            step += block;
+        }
+    }
+
+    ulint n = 0; // Length of BWT
+    ulint r = 0; // Runs of BWT
+    ulint d = 0; // Splitting parameter, 0 if unknown or not split
+
+    vector<LF_row> LF_runs; // Rows built or loaded in memory, empty if mapped
+
+    const LF_row *rows = nullptr; // Rows queried, either LF_runs or inside the mapping
+    std::shared_ptr<mapped_file> mapping;
 
-    vector<LF_row> LF_runs;
+    scan_fn<LF_row> scan = select_scan<LF_row>();
 };
 
 #endif /* end of include guard: _LF_TABLE_HH */
\ No newline at end of file
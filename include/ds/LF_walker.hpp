@@ -0,0 +1,194 @@
+/* LF_walker - Coroutine walkers interleaving independent LF walks to hide memory latency
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file LF_walker.hpp
+   \brief LF_walker.hpp Coroutine walkers (C++20) over a permute table, interleaved round-robin by a scheduler
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#ifndef _LF_WALKER_HH
+#define _LF_WALKER_HH
+
+#include <common.hpp>
+
+#include <coroutine>
+#include <exception>
+
+using namespace std;
+
+/*
+ * Handle to a walk, written as a coroutine which uses co_await LF_step(...) for each step.
+ * Walkers start suspended, and are driven by LF_scheduler.
+ */
+class LF_walker
+{
+public:
+    struct promise_type
+    {
+        LF_walker get_return_object()
+        {
+            return LF_walker(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    LF_walker() {}
+
+    LF_walker(LF_walker &&other) : handle(other.handle)
+    {
+        other.handle = nullptr;
+    }
+
+    LF_walker &operator=(LF_walker &&other)
+    {
+        if (this != &other)
+        {
+            if (handle) handle.destroy();
+            handle = other.handle;
+            other.handle = nullptr;
+        }
+        return *this;
+    }
+
+    LF_walker(const LF_walker &) = delete;
+    LF_walker &operator=(const LF_walker &) = delete;
+
+    ~LF_walker()
+    {
+        if (handle) handle.destroy();
+    }
+
+    bool done()
+    {
+        return !handle || handle.done();
+    }
+
+    void resume()
+    {
+        handle.resume();
+    }
+
+private:
+    std::coroutine_handle<promise_type> handle = nullptr;
+
+    explicit LF_walker(std::coroutine_handle<promise_type> h) : handle(h) {}
+};
+
+/*
+ * Awaitable LF step. Suspends right after prefetching the destination row, and resumes by scanning it.
+ * The row of the resulting run is the one read by the following step, so it is already cached.
+ * Requires table_t to provide LF_prefetch and LF_scan.
+ */
+template < class table_t >
+class LF_step
+{
+public:
+    LF_step(table_t &t, ulint run, ulint offset) : table(t), pos(run, offset) {}
+
+    LF_step(table_t &t, std::pair<ulint, ulint> p) : table(t), pos(p) {}
+
+    bool await_ready() { return false; }
+
+    void await_suspend(std::coroutine_handle<>)
+    {
+        pos = table.LF_prefetch(pos.first, pos.second);
+    }
+
+    std::pair<ulint, ulint> await_resume()
+    {
+        return table.LF_scan(pos.first, pos.second);
+    }
+
+private:
+    table_t &table;
+    std::pair<ulint, ulint> pos;
+};
+
+/*
+ * Runs walkers to completion on the calling thread, resuming up to width of them round-robin
+ * so the memory latency of one walker overlaps with the work of the others.
+ */
+class LF_scheduler
+{
+public:
+    LF_scheduler(size_t w = 16) : width(w ? w : 1) {}
+
+    /*
+     * \param Number of walkers to run
+     * \param Function returning the walker for a given index, called lazily when a slot is free
+     */
+    template < class make_t >
+    void run(ulint count, make_t make)
+    {
+        vector<LF_walker> slots;
+        slots.reserve(width);
+
+        ulint next = 0;
+        while (next < count && slots.size() < width)
+        {
+            slots.push_back(make(next++));
+        }
+
+        while (!slots.empty())
+        {
+            for (size_t i = 0; i < slots.size();)
+            {
+                slots[i].resume();
+
+                if (!slots[i].done())
+                {
+                    ++i;
+                }
+                else if (next < count)
+                {
+                    slots[i] = make(next++);
+                    ++i;
+                }
+                else
+                {
+                    slots[i] = std::move(slots.back());
+                    slots.pop_back();
+                }
+            }
+        }
+    }
+
+private:
+    size_t width;
+};
+
+/*
+ * Walker taking a fixed number of LF steps
+ * \param Table to step through
+ * \param Starting position (run, offset)
+ * \param Number of steps
+ * \param Position after the walk
+ */
+template < class table_t >
+LF_walker LF_walk(table_t &table, std::pair<ulint, ulint> start, ulint steps, std::pair<ulint, ulint> &end)
+{
+    std::pair<ulint, ulint> pos = start;
+    for (ulint i = 0; i < steps; ++i)
+    {
+        pos = co_await LF_step<table_t>(table, pos);
+    }
+    end = pos;
+}
+
+#endif /* end of include guard: _LF_WALKER_HH */
@@ -0,0 +1,184 @@
+/* bucket_pq - Max priority queue of dense ids with small integer weights
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file bucket_pq.hpp
+   \brief bucket_pq.hpp Bucket queue of dense ids, with the interface of index_pq, used to split runs in deterministic
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#ifndef __BUCKET_PQ_HH
+#define __BUCKET_PQ_HH
+
+#include <common.hpp>
+#include <stdexcept>
+
+#include <sdsl/structure_tree.hpp>
+#include <sdsl/util.hpp>
+#include <sdsl/int_vector.hpp>
+
+/*
+ * Each weight has a bucket, a doubly linked list of the ids of that weight threaded through flat arrays indexed by
+ * id, so push, promote and demote take O(1) time. The maximum is found by moving a cursor down from the largest
+ * weight pushed or promoted to, so its moves down are paid for by the moves up. Weights are bounded by the number of
+ * ids, which holds for the weight of a run in deterministic (the run heads of L it covers).
+ */
+class bucket_pq
+{
+public:
+    bucket_pq() {}
+
+    // Ids are in [0, limit), weights in [0, limit]
+    bucket_pq(size_t _limit)
+    {
+        limit = _limit;
+        n = 0;
+        top = 0;
+
+        // limit marks the end of a list, and ids not in the queue
+        uint8_t id_bits = bitsize(uint64_t(limit));
+        next = int_vector<>(limit, limit, id_bits);
+        prev = int_vector<>(limit, limit, id_bits);
+        weights = int_vector<>(limit, 0, id_bits);
+        present = bit_vector(limit, false);
+        buckets = int_vector<>(1, limit, id_bits);
+    }
+
+    bool is_empty() {
+        return n == 0;
+    }
+
+    bool contains(size_t i) {
+        return i < limit && present[i];
+    }
+
+    size_t size() {
+        return n;
+    }
+
+    void push(ulint i, ulint k)
+    {
+        if (i >= limit) throw std::invalid_argument("Index " + std::to_string(i) + " past the limit of the heap");
+        if (contains(i)) throw std::invalid_argument("Index " + std::to_string(i) + " already in heap");
+
+        present[i] = true;
+        link(i, k);
+        ++n;
+    }
+
+    pair<ulint, ulint> get_max() {
+        if (is_empty()) throw std::invalid_argument("Heap is empty");
+
+        while (buckets[top] == limit) --top;
+        return make_pair((ulint) top, (ulint) buckets[top]);
+    }
+
+    ulint get_weight(ulint i) {
+        return weights[i];
+    }
+
+    void promote (ulint i, ulint k)
+    {
+        if (!contains(i)) throw std::invalid_argument("Index not in heap");
+        if (weights[i] >= k) throw std::invalid_argument("Given key is not greater than existing key");
+
+        unlink(i);
+        link(i, k);
+    }
+
+    void demote (ulint i, ulint k)
+    {
+        if (!contains(i)) throw std::invalid_argument("Index not in heap");
+        if (weights[i] <= k) throw std::invalid_argument("Given key is not less than existing key");
+
+        unlink(i);
+        link(i, k);
+    }
+
+    size_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, std::string name ="")
+    {
+        size_t written_bytes = 0;
+
+        out.write((char *)&n, sizeof(n));
+        written_bytes += sizeof(n);
+
+        out.write((char *)&limit, sizeof(limit));
+        written_bytes += sizeof(limit);
+
+        out.write((char *)&top, sizeof(top));
+        written_bytes += sizeof(top);
+
+        written_bytes += next.serialize(out, v, "next");
+        written_bytes += prev.serialize(out, v, "prev");
+        written_bytes += weights.serialize(out, v, "weights");
+        written_bytes += present.serialize(out, v, "present");
+        written_bytes += buckets.serialize(out, v, "buckets");
+
+        return written_bytes;
+    }
+
+    void load(std::istream &in)
+    {
+        in.read((char *)&n, sizeof(n));
+        in.read((char *)&limit, sizeof(limit));
+        in.read((char *)&top, sizeof(top));
+
+        next.load(in);
+        prev.load(in);
+        weights.load(in);
+        present.load(in);
+        buckets.load(in);
+    }
+
+private:
+    int_vector<> next; // Next id in the bucket of an id
+    int_vector<> prev; // Previous id in the bucket of an id
+    int_vector<> weights; // Weight of an id
+    bit_vector present; // Whether an id is in the queue
+    int_vector<> buckets; // First id of each weight, grown as larger weights are pushed
+
+    size_t n; // size of heap
+    size_t limit; // max id (exclusive)
+    size_t top; // No bucket above top holds an id
+
+    // Adds i to the front of the bucket of weight k
+    void link(ulint i, ulint k)
+    {
+        if (k > limit) throw std::invalid_argument("Weight " + std::to_string(k) + " past the limit of the heap");
+        if (k >= buckets.size())
+        {
+            size_t old_size = buckets.size();
+            buckets.resize(std::min(std::max(k + 1, 2 * old_size), limit + 1));
+            for (size_t w = old_size; w < buckets.size(); ++w) buckets[w] = limit;
+        }
+
+        weights[i] = k;
+        prev[i] = limit;
+        next[i] = buckets[k];
+        if (buckets[k] != limit) prev[buckets[k]] = i;
+        buckets[k] = i;
+
+        if (k > top) top = k;
+    }
+
+    // Removes i from its bucket
+    void unlink(ulint i)
+    {
+        if (prev[i] != limit) next[prev[i]] = next[i];
+        else buckets[weights[i]] = next[i];
+        if (next[i] != limit) prev[next[i]] = prev[i];
+    }
+};
+
+#endif // __BUCKET_PQ_HH
@@ -0,0 +1,469 @@
+/* dynamic_LF_table - LF table over dynamic rows, supporting insertion of texts
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file dynamic_LF_table.hpp
+   \brief dynamic_LF_table.hpp LF table with rows stored in dynamic B-trees (DYNAMIC), so texts are added to its collection in place
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#ifndef _DYNAMIC_LF_TABLE_HH
+#define _DYNAMIC_LF_TABLE_HH
+
+#include <common.hpp>
+#include <LF_table.hpp>
+#include <rlbwt_reader.hpp>
+
+#include <../../thirdparty/dynamic/dynamic.hpp>
+
+using namespace std;
+using namespace dyn;
+
+/*
+ * Rows are kept in L order as their characters (a dynamic wavelet matrix) and lengths (a searchable partial sum),
+ * and the lengths of the rows of each character are also kept in F order. Rather than pointing at rows by index,
+ * which every insertion would shift, LF finds the start of a row in F as the lengths of earlier rows of its
+ * character, and the row holding a position by searching the partial sums, in O(log r) time in the worst case,
+ * whatever the runs. A text is added by inserting its characters last to first, each at the position the previous
+ * one maps to, which extends, splits or adds a row, so rows are never rebuilt.
+ *
+ * Rows split with d keep the bound of fewer than 2d heads of L in the range of F of each row. Inserting a text adds
+ * a row to the BWT matrix for each of its characters, moving heads and ranges only around it, so only the rows
+ * covering the positions of the characters in L and F are checked, and a heavy row is cut at every d-th head of L in
+ * its range of F, as offline_balance cuts. A cut adds a head of L inside the row cut, and the row of F covering it is
+ * queued to be checked in turn.
+ */
+class dynamic_LF_table
+{
+public:
+    dynamic_LF_table() {}
+
+    // Rows of the table, kept as they are (including splits), and kept split with its splitting parameter
+    dynamic_LF_table(LF_table &table)
+    {
+        d = table.split_param();
+        for (ulint i = 0; i < table.runs(); ++i)
+        {
+            LF_table::LF_row row = table.get(i);
+            push_back(row.character, row.length);
+        }
+    }
+
+    // Runs of the BWT, mapped
+    dynamic_LF_table(const rlbwt_reader &rlbwt)
+    {
+        rlbwt.for_each_run([&](char c, ulint length) {
+            if (c <= TERMINATOR) c = TERMINATOR;
+            push_back(c, length);
+        });
+    }
+
+    ulint size()
+    {
+        return n;
+    }
+
+    ulint runs()
+    {
+        return lengths.size();
+    }
+
+    // Splitting parameter the rows are kept split with, 0 if not split
+    ulint split_param()
+    {
+        return d;
+    }
+
+    /*
+     * Cuts every row with 2d or more heads of L in its range of F, and keeps the rows split with d as texts are added.
+     * Rows are only cut, so splitting with a larger d keeps the rows as they are
+     * \param Splitting parameter, 0 to stop splitting
+     */
+    void split_rows(ulint _d)
+    {
+        if (_d == 1) error("Splitting parameter must be at least 2 (0 to not split)");
+        d = _d;
+        if (d == 0) return;
+
+        vector<ulint> queue;
+        for (ulint i = 0; i < runs(); ++i)
+        {
+            queue.push_back(F_position(i, 0));
+        }
+        balance(queue);
+    }
+
+    uchar get_char(ulint run)
+    {
+        return heads.at(run);
+    }
+
+    ulint get_length(ulint run)
+    {
+        return lengths.at(run);
+    }
+
+    // Position of an offset into a run
+    ulint position(ulint run, ulint offset)
+    {
+        return start(run) + offset;
+    }
+
+    // Run and offset holding a position
+    std::pair<ulint, ulint> locate(ulint pos)
+    {
+        ulint run = lengths.search(pos + 1);
+        return std::make_pair(run, pos - start(run));
+    }
+
+    /*
+     * \param Run position (RLE intervals)
+     * \param Current character offset in block
+     * \return block position and offset of preceding character
+     */
+    std::pair<ulint, ulint> LF(ulint run, ulint offset)
+    {
+        return locate(F_position(run, offset));
+    }
+
+    /*
+     * Adds a text to the collection, its terminator sorting after those already in it, as LF_merge adds a table
+     * \param Text, without terminator
+     */
+    void insert(const std::string &text)
+    {
+        // The suffix holding only the new terminator comes after the suffixes holding the others
+        ulint pos = C[TERMINATOR + 1];
+        for (size_t i = text.size(); i > 0; --i)
+        {
+            uchar c = text[i - 1];
+            if (c <= TERMINATOR) error("Texts inserted cannot contain the terminator, at position", i - 1);
+
+            // The new terminator is already in F, before any suffix starting with c, but not yet in L
+            pos = insert_char(pos, c) + 1;
+        }
+        insert_char(pos, TERMINATOR);
+
+        if (d > 0) balance_inserted(pos, text.size());
+    }
+
+    /*
+     * Calls emit(c, length) for every run of the BWT in order, joining neighbouring rows of the same character
+     * \return Number of runs
+     */
+    template < class emit_t >
+    ulint for_each_run(emit_t emit)
+    {
+        ulint count = 0;
+        char last_c = 0;
+        ulint length = 0;
+        for (ulint i = 0; i < runs(); ++i)
+        {
+            char c = heads.at(i);
+            if (length != 0 && c == last_c)
+            {
+                length += lengths.at(i);
+                continue;
+            }
+
+            if (length != 0)
+            {
+                emit(last_c, length);
+                ++count;
+            }
+            last_c = c;
+            length = lengths.at(i);
+        }
+
+        if (length != 0)
+        {
+            emit(last_c, length);
+            ++count;
+        }
+
+        return count;
+    }
+
+    /*
+     * Calls emit(c, length) for every row in L order, as they are
+     * \return Number of rows
+     */
+    template < class emit_t >
+    ulint for_each_row(emit_t emit)
+    {
+        for (ulint i = 0; i < runs(); ++i)
+        {
+            emit(heads.at(i), lengths.at(i));
+        }
+
+        return runs();
+    }
+
+    /*
+     * Writes the BWT as heads and lengths, to build static tables as for any RLBWT
+     * \param Path of the BWT, writing bwt_fname.heads and bwt_fname.len
+     * \return Number of runs
+     */
+    ulint write(std::string bwt_fname)
+    {
+        return write_rlbwt(bwt_fname, [&](auto emit) { return for_each_run(emit); });
+    }
+
+    std::string get_file_extension() const
+    {
+        return ".dynamic_LF_table";
+    }
+
+    void bwt_stats()
+    {
+        verbose("Number of rows: r = ", runs());
+        verbose("Length of complete BWT: n = ", n);
+        verbose("Rate n/r = ", double(n) / runs());
+    }
+
+    /* serialize to the ostream
+    * \param out     the ostream
+    */
+    size_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, std::string name ="")
+    {
+        size_t written_bytes = 0;
+
+        out.write((char *)&n, sizeof(n));
+        written_bytes += sizeof(n);
+        out.write((char *)&d, sizeof(d));
+        written_bytes += sizeof(d);
+
+        // Rows of each character are rebuilt on load (DYNAMIC cannot load an empty partial sum)
+        if (n > 0)
+        {
+            written_bytes += heads.serialize(out);
+            written_bytes += lengths.serialize(out);
+        }
+
+        return written_bytes;
+    }
+
+    /* load from the istream
+    * \param in the istream
+    */
+    void load(std::istream &in)
+    {
+        ulint length;
+        in.read((char *)&length, sizeof(length));
+        in.read((char *)&d, sizeof(d));
+        if (length == 0) return;
+
+        wm_string<suc_bv> loaded_heads;
+        packed_spsi loaded_lengths;
+        loaded_heads.load(in);
+        loaded_lengths.load(in);
+
+        for (ulint i = 0; i < loaded_lengths.size(); ++i)
+        {
+            push_back(loaded_heads.at(i), loaded_lengths.at(i));
+        }
+    }
+
+private:
+    // Start of a run in L
+    ulint start(ulint run)
+    {
+        return (run > 0) ? lengths.psum(run - 1) : 0;
+    }
+
+    // Position in F of an offset into a run, after the earlier rows of its character
+    ulint F_position(ulint run, ulint offset)
+    {
+        uchar c = heads.at(run);
+        ulint rank = heads.rank(run, c);
+        return C[c] + ((rank > 0) ? char_lengths[c].psum(rank - 1) : 0) + offset;
+    }
+
+    // Row covering a position of F
+    ulint F_row(ulint pos)
+    {
+        uchar c = std::upper_bound(C.begin(), C.end(), pos) - C.begin() - 1;
+        ulint rank = char_lengths[c].search(pos - C[c] + 1);
+        return heads.select(rank + 1, c) - 1;
+    }
+
+    // Rows of L starting before a position
+    ulint heads_before(ulint pos)
+    {
+        return (pos > 0) ? locate(pos - 1).first + 1 : 0;
+    }
+
+    /*
+     * Cuts the rows of F covering the positions queued while they have 2d or more heads of L in their range of F,
+     * at every d-th head, queueing the positions of the heads of L added by the cuts. Cuts move no position, so
+     * positions queued stay valid
+     */
+    void balance(vector<ulint> &queue)
+    {
+        while (!queue.empty())
+        {
+            ulint run = F_row(queue.back());
+            queue.pop_back();
+
+            while (true)
+            {
+                ulint from = F_position(run, 0);
+                ulint first = heads_before(from);
+                if (heads_before(from + lengths.at(run)) - first < 2*d) break;
+
+                // The d-th head starts the row cut out, which starts inside run in L
+                ulint offset = start(first + d) - from;
+                queue.push_back(start(run) + offset);
+                split(run, offset);
+                ++run;
+            }
+        }
+    }
+
+    /*
+     * Cuts the rows around the characters of a text just inserted. Until the terminator is inserted it is in F but
+     * not in L, so the rows are only checked once the text is whole
+     * \param Position in L of the terminator
+     * \param Length of the text, without terminator
+     */
+    void balance_inserted(ulint pos, ulint length)
+    {
+        vector<ulint> queue;
+
+        // Terminators map to F by rank, so the ranges of F of the rows of terminators from the new one on move
+        queue_heads(pos, queue);
+        std::pair<ulint, ulint> terminator = locate(pos);
+        for (ulint F_pos = F_position(terminator.first, terminator.second); F_pos < C[TERMINATOR + 1];)
+        {
+            ulint run = F_row(F_pos);
+            queue.push_back(F_pos);
+            F_pos = F_position(run, 0) + lengths.at(run);
+        }
+
+        // Its characters, last to first, walking LF from its suffix holding only the terminator, the last in F
+        pos = C[TERMINATOR + 1] - 1;
+        for (ulint i = 0; i < length; ++i)
+        {
+            std::pair<ulint, ulint> at = locate(pos);
+            ulint F_pos = F_position(at.first, at.second);
+
+            // The row of the character, its range of F grown
+            queue_heads(pos, queue);
+            queue.push_back(F_pos);
+            pos = F_pos;
+        }
+
+        balance(queue);
+    }
+
+    // Queues the rows of F covering the heads of L a character inserted at pos may add
+    void queue_heads(ulint pos, vector<ulint> &queue)
+    {
+        queue.push_back(pos);
+        if (pos + 1 < n) queue.push_back(pos + 1);
+    }
+
+    void push_back(uchar c, ulint length)
+    {
+        heads.push_back(c);
+        lengths.push_back(length);
+        char_lengths[c].push_back(length);
+        count_char(c, length);
+        n += length;
+    }
+
+    // Counts length more positions of character c, moving the start in F of the characters after it
+    void count_char(uchar c, ulint length)
+    {
+        for (size_t x = c + 1; x <= ALPHABET_SIZE; ++x)
+        {
+            C[x] += length;
+        }
+    }
+
+    /*
+     * Inserts character c at position pos of L, extending the run before or after it if it has character c,
+     * splitting the run holding it otherwise
+     * \return Position in F of the inserted character, counting the characters in L
+     */
+    ulint insert_char(ulint pos, uchar c)
+    {
+        ulint run;
+        if (pos > 0 && heads.at(locate(pos - 1).first) == c)
+        {
+            run = locate(pos - 1).first;
+            extend(run);
+        }
+        else if (pos < n && locate(pos).second == 0 && heads.at(locate(pos).first) == c)
+        {
+            run = locate(pos).first;
+            extend(run);
+        }
+        else
+        {
+            run = runs();
+            if (pos < n)
+            {
+                std::pair<ulint, ulint> at = locate(pos);
+                if (at.second > 0) split(at.first, at.second);
+                run = at.first + (at.second > 0);
+            }
+            insert_row(run, c);
+        }
+        n += 1;
+
+        return F_position(run, pos - start(run));
+    }
+
+    void extend(ulint run)
+    {
+        uchar c = heads.at(run);
+        lengths.increment(run, 1);
+        char_lengths[c].increment(heads.rank(run, c), 1);
+        count_char(c, 1);
+    }
+
+    // Cuts run into [0, offset) and [offset, length)
+    void split(ulint run, ulint offset)
+    {
+        uchar c = heads.at(run);
+        ulint rank = heads.rank(run, c);
+        ulint length = lengths.at(run);
+
+        lengths.set(run, offset);
+        lengths.insert(run + 1, length - offset);
+        heads.insert(run + 1, c);
+        char_lengths[c].set(rank, offset);
+        char_lengths[c].insert(rank + 1, length - offset);
+    }
+
+    // Adds a row of length 1 before run
+    void insert_row(ulint run, uchar c)
+    {
+        heads.insert(run, c);
+        lengths.insert(run, 1);
+        char_lengths[c].insert(heads.rank(run, c), 1);
+        count_char(c, 1);
+    }
+
+    ulint n = 0; // Length of BWT
+    ulint d = 0; // Splitting parameter, 0 if not split
+
+    wm_string<suc_bv> heads = wm_string<suc_bv>(ALPHABET_SIZE - 1); // Character of each row, in L order
+    packed_spsi lengths; // Length of each row, in L order
+    vector<packed_spsi> char_lengths = vector<packed_spsi>(ALPHABET_SIZE); // Lengths of the rows of each character, in F order
+    vector<ulint> C = vector<ulint>(ALPHABET_SIZE + 1, 0); // Positions with a smaller character
+};
+
+#endif /* end of include guard: _DYNAMIC_LF_TABLE_HH */
@@ -0,0 +1,203 @@
+/* packed_LF_table - Bit-packed version of the LF table
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file packed_LF_table.hpp
+   \brief packed_LF_table.hpp Bit-packed version of the LF table, each field stored in its own column of minimal width
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#ifndef _PACKED_LF_TABLE_HH
+#define _PACKED_LF_TABLE_HH
+
+#include <common.hpp>
+#include <LF_table.hpp>
+
+#include <sdsl/int_vector.hpp>
+#include <sdsl/structure_tree.hpp>
+#include <sdsl/util.hpp>
+
+using namespace std;
+using namespace sdsl;
+
+class packed_LF_table
+{
+public:
+    packed_LF_table() {}
+
+    // Pack the rows of an existing table, using bitsize of the largest value for each column
+    packed_LF_table(LF_table &table)
+    {
+        n = table.size();
+        r = table.runs();
+
+        ulint max_length = 0;
+        ulint max_offset = 0;
+        for (size_t i = 0; i < r; ++i)
+        {
+            LF_table::LF_row row = table.get(i);
+            if (row.length > max_length) max_length = row.length;
+            if (row.offset > max_offset) max_offset = row.offset;
+        }
+
+        characters = int_vector<8>(r, 0);
+        intervals = int_vector<>(r, 0, bitsize(uint64_t(r)));
+        lengths = int_vector<>(r, 0, bitsize(uint64_t(max_length)));
+        offsets = int_vector<>(r, 0, bitsize(uint64_t(max_offset)));
+
+        for (size_t i = 0; i < r; ++i)
+        {
+            LF_table::LF_row row = table.get(i);
+            characters[i] = (uchar) row.character;
+            intervals[i] = row.interval;
+            lengths[i] = row.length;
+            offsets[i] = row.offset;
+        }
+
+        mem_stats();
+    }
+
+    const LF_table::LF_row get(size_t i)
+    {
+        assert(i < r);
+        return {(char) characters[i], lengths[i], intervals[i], offsets[i]};
+    }
+
+    ulint size()
+    {
+        return n;
+    }
+
+    ulint runs()
+    {
+        return r;
+    }
+
+    void invert(std::string outfile)
+    {
+        std::ofstream out(outfile);
+
+        ulint interval = 0;
+        ulint offset = 0;
+
+        char c;
+        while((c = get_char(interval)) > TERMINATOR)
+        {
+            out << c;
+            std::pair<ulint, ulint> pos = LF(interval, offset);
+            interval = pos.first;
+            offset = pos.second;
+        }
+    }
+
+    /*
+     * \param Run position (RLE intervals)
+     * \param Current character offset in block
+     * \return block position and offset of preceding character
+     */
+    std::pair<ulint, ulint> LF(ulint run, ulint offset)
+    {
+        ulint next_interval = intervals[run];
+        ulint next_offset = offsets[run] + offset;
+
+        ulint length;
+        while (next_offset >= (length = lengths[next_interval]))
+        {
+            next_offset -= length;
+            ++next_interval;
+        }
+
+        return std::make_pair(next_interval, next_offset);
+    }
+
+    uchar get_char(ulint i)
+    {
+        assert(i < r);
+        return characters[i];
+    }
+
+    std::string get_file_extension() const
+    {
+        return ".packed_LF_table";
+    }
+
+    void mem_stats()
+    {
+        sdsl::nullstream ns;
+
+        verbose("Memory consumption (bytes).");
+        verbose("       Packed LF table: ", serialize(ns));
+        verbose("            characters: ", characters.serialize(ns));
+        verbose("             intervals: ", intervals.serialize(ns), " (", int(intervals.width()), " bits)");
+        verbose("               lengths: ", lengths.serialize(ns), " (", int(lengths.width()), " bits)");
+        verbose("               offsets: ", offsets.serialize(ns), " (", int(offsets.width()), " bits)");
+    }
+
+    void bwt_stats()
+    {
+        ulint n = size();
+        ulint r = runs();
+        verbose("Number of BWT equal-letter runs: r = ", r);
+        verbose("Length of complete BWT: n = ", n);
+        verbose("Rate n/r = ", double(n) / r);
+        verbose("log2(r) = ", log2(double(r)));
+        verbose("log2(n/r) = ", log2(double(n) / r));
+    }
+
+    /* serialize to the ostream
+    * \param out     the ostream
+    */
+    size_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, std::string name ="")
+    {
+        size_t written_bytes = 0;
+
+        out.write((char *)&n, sizeof(n));
+        written_bytes += sizeof(n);
+
+        out.write((char *)&r, sizeof(r));
+        written_bytes += sizeof(r);
+
+        written_bytes += characters.serialize(out, v, "characters");
+        written_bytes += intervals.serialize(out, v, "intervals");
+        written_bytes += lengths.serialize(out, v, "lengths");
+        written_bytes += offsets.serialize(out, v, "offsets");
+
+        return written_bytes;
+    }
+
+    /* load from the istream
+    * \param in the istream
+    */
+    void load(std::istream &in)
+    {
+        in.read((char *)&n, sizeof(n));
+        in.read((char *)&r, sizeof(r));
+
+        characters.load(in);
+        intervals.load(in);
+        lengths.load(in);
+        offsets.load(in);
+    }
+
+private:
+    ulint n; // Length of BWT
+    ulint r; // Runs of BWT
+
+    int_vector<8> characters;
+    int_vector<> intervals;
+    int_vector<> lengths;
+    int_vector<> offsets;
+};
+
+#endif /* end of include guard: _PACKED_LF_TABLE_HH */
@@ -0,0 +1,391 @@
+/* permute_table - Table supporting a general permutation, stored as runs of consecutive values
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file permute_table.hpp
+   \brief permute_table.hpp Table supporting a general permutation (e.g. phi, inverse phi) over its maximal runs, optionally split with parameter d
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#ifndef _PERMUTE_TABLE_HH
+#define _PERMUTE_TABLE_HH
+
+#include <common.hpp>
+#include <mapped_file.hpp>
+#include <row_scan.hpp>
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+#include <sdsl/int_vector.hpp>
+#include <sdsl/structure_tree.hpp>
+#include <sdsl/util.hpp>
+
+// Serialized tables start with this word, followed by the format version ("PM_table" in little endian)
+#define PERMUTE_TABLE_MAGIC 0x656c6261745f4d50ULL
+#define PERMUTE_TABLE_VERSION 1
+// Words written by serialize before the rows: magic, version, n, r, d
+#define PERMUTE_TABLE_HEADER_WORDS 5
+
+using namespace std;
+
+class permute_table
+{
+public:
+    // Run of the permutation, positions [start, start + length) going to [destination, destination + length)
+    struct permute_run
+    {
+        ulint start;
+        ulint length;
+        ulint destination;
+    };
+
+    // Row of the table, the run starting at start, whose destination is offset into row interval
+    struct permute_row
+    {
+        ulint start;
+        ulint length;
+        ulint interval;
+        ulint offset;
+    };
+
+    permute_table() {}
+
+    /*
+     * \param Permutation of [0, n), as the value of each position
+     * \param Splitting parameter, so apply scans less than 2d rows (0 to not split)
+     */
+    permute_table(const sdsl::int_vector<> &permutation, ulint d = 0)
+    {
+        build(find_runs(permutation, permutation.size()), d);
+    }
+
+    /*
+     * \param Path of a file of 64-bit values, the permutation of [0, n), mapped while building
+     * \param Splitting parameter, so apply scans less than 2d rows (0 to not split)
+     */
+    permute_table(std::string fname, ulint d = 0)
+    {
+        mapped_file file(fname);
+        file.advise(MADV_SEQUENTIAL);
+        if (file.size() % sizeof(ulint) != 0) error("Size of", fname, "is not a multiple of 8 bytes");
+
+        build(find_runs((const ulint *) file.data(), file.size() / sizeof(ulint)), d);
+    }
+
+    /*
+     * \param Stream of runs, each as 64-bit start, length and destination, in any order. The runs must cover [0, n)
+     *        and their destinations must too, consecutive runs continuing each other are joined.
+     * \param Splitting parameter, so apply scans less than 2d rows (0 to not split)
+     */
+    permute_table(std::istream &in, ulint d = 0)
+    {
+        vector<permute_run> runs;
+        permute_run run;
+        while (in.read((char *)&run, sizeof(run)))
+        {
+            if (run.length > 0) runs.push_back(run);
+        }
+
+        build(join_runs(runs), d);
+    }
+
+    const permute_row get(size_t i)
+    {
+        assert(i < r);
+        return rows[i];
+    }
+
+    ulint size()
+    {
+        return n;
+    }
+
+    ulint runs()
+    {
+        return r;
+    }
+
+    // Splitting parameter of the table, 0 if not split
+    ulint split_param()
+    {
+        return d;
+    }
+
+    /*
+     * \param Run position (RLE intervals)
+     * \param Offset in the run
+     * \return Run position and offset of the value of that position
+     */
+    std::pair<ulint, ulint> apply(ulint run, ulint offset)
+    {
+        ulint next_interval = rows[run].interval;
+        ulint next_offset = rows[run].offset + offset;
+
+        if (next_offset < rows[next_interval].length)
+        {
+            return std::make_pair(next_interval, next_offset);
+        }
+
+        return scan(rows.data(), r, next_interval, next_offset);
+    }
+
+    // Position of an offset into a run
+    ulint position(ulint run, ulint offset)
+    {
+        return rows[run].start + offset;
+    }
+
+    /* Choose the kernel used to scan rows, limited to what the CPU supports (default is the best supported).
+     * If specialize is set and the table is split, the kernel specialized for the splitting parameter is used instead.
+     */
+    void set_scan(scan_isa isa, bool specialize = false)
+    {
+        scan = select_scan<permute_row>(isa, specialize ? d : 0);
+    }
+
+    std::string get_file_extension() const
+    {
+        return ".permute_table";
+    }
+
+    void mem_stats()
+    {
+        verbose("Memory consumption (bytes).");
+        verbose("              Permute table: ", serialized_size());
+    }
+
+    void permutation_stats()
+    {
+        verbose("Number of runs: r = ", r);
+        verbose("Length of permutation: n = ", n);
+        verbose("Rate n/r = ", double(n) / r);
+        verbose("Splitting parameter: d = ", d);
+    }
+
+    /* serialize to the ostream
+    * \param out     the ostream
+    */
+    size_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, std::string name ="")
+    {
+        ulint header[PERMUTE_TABLE_HEADER_WORDS] = {PERMUTE_TABLE_MAGIC, PERMUTE_TABLE_VERSION, n, r, d};
+        out.write((char *)header, sizeof(header));
+        out.write((char *)rows.data(), r * sizeof(permute_row));
+
+        return serialized_size();
+    }
+
+    // Bytes written by serialize, without writing
+    size_t serialized_size() const
+    {
+        return PERMUTE_TABLE_HEADER_WORDS * sizeof(ulint) + r * sizeof(permute_row);
+    }
+
+    /* load from the istream
+    * \param in the istream
+    */
+    void load(std::istream &in)
+    {
+        ulint header[PERMUTE_TABLE_HEADER_WORDS];
+        in.read((char *)header, sizeof(header));
+        if (header[0] != PERMUTE_TABLE_MAGIC) error("Not a permute table");
+        if (header[1] > PERMUTE_TABLE_VERSION) error("Permute table version", header[1], "is newer than supported version", PERMUTE_TABLE_VERSION);
+
+        n = header[2];
+        r = header[3];
+        d = header[4];
+
+        rows = vector<permute_row>(r);
+        in.read((char *)rows.data(), r * sizeof(permute_row));
+
+        set_scan(detect_scan_isa());
+    }
+
+private:
+    /*
+     * Maximal runs of consecutive values of a permutation of [0, n), in order
+     * \param Values, indexed as an array
+     * \param Length of the permutation
+     */
+    template < class values_t >
+    static vector<permute_run> find_runs(const values_t &values, ulint n)
+    {
+        vector<permute_run> runs;
+        sdsl::bit_vector seen(n, 0);
+
+        for (ulint i = 0; i < n; ++i)
+        {
+            ulint value = values[i];
+            if (value >= n || seen[value]) error("Not a permutation, value", value, "at position", i);
+            seen[value] = 1;
+
+            if (i > 0 && value == runs.back().destination + runs.back().length) ++runs.back().length;
+            else runs.push_back({i, 1, value});
+        }
+
+        return runs;
+    }
+
+    // Sorts runs by start, checking they and their destinations cover [0, n), and joins runs continuing each other
+    static vector<permute_run> join_runs(vector<permute_run> &runs)
+    {
+        std::sort(runs.begin(), runs.end(), [](const permute_run &a, const permute_run &b) { return a.start < b.start; });
+
+        vector<ulint> destinations(runs.size());
+        vector<permute_run> joined;
+        ulint end = 0;
+        for (size_t i = 0; i < runs.size(); ++i)
+        {
+            if (runs[i].start != end) error("Runs do not cover position", end);
+            end += runs[i].length;
+            destinations[i] = runs[i].destination;
+
+            permute_run *last = joined.empty() ? nullptr : &joined.back();
+            if (last && runs[i].destination == last->destination + last->length) last->length += runs[i].length;
+            else joined.push_back(runs[i]);
+        }
+
+        // Destinations cover [0, n) exactly if, in order, each ends where the next starts
+        vector<size_t> order(runs.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return destinations[a] < destinations[b]; });
+
+        ulint dest_end = 0;
+        for (size_t i : order)
+        {
+            if (runs[i].destination != dest_end) error("Destinations of runs do not cover position", dest_end);
+            dest_end += runs[i].length;
+        }
+
+        return joined;
+    }
+
+    /*
+     * Splits runs until the destination of every run overlaps less than 2d run starts, as deterministic splits the
+     * runs of the BWT. Destinations of the runs are checked from a work queue. If the destination of a run overlaps
+     * 2d or more starts, it is cut at the d-th start it overlaps, which cuts the run at the position mapped there. Both
+     * parts of the destination, and the destination overlapping the new start, are queued to be checked again. Only
+     * the run boundaries are kept, so memory is O(r) rather than O(n).
+     * \param Runs in order, replaced by the split runs in order
+     */
+    static void split_runs(vector<permute_run> &runs, ulint d, ulint n)
+    {
+        std::set<ulint> starts; // Start of every run
+        std::map<ulint, ulint> sources; // Start of every run, by its destination
+        vector<ulint> queue; // Destinations to check
+        for (permute_run &run : runs)
+        {
+            starts.insert(run.start);
+            sources[run.destination] = run.start;
+            queue.push_back(run.destination);
+        }
+
+        ulint count = 0;
+        while (!queue.empty())
+        {
+            ulint destination = queue.back();
+            queue.pop_back();
+
+            std::map<ulint, ulint>::iterator it = sources.find(destination);
+            std::map<ulint, ulint>::iterator next = std::next(it);
+            ulint end = (next == sources.end()) ? n : next->first;
+
+            // Find the d-th start overlapped, stopping once 2d are found
+            ulint overlapped = 0;
+            ulint cut = 0;
+            for (std::set<ulint>::iterator s = starts.lower_bound(destination); s != starts.end() && *s < end && overlapped < 2*d; ++s)
+            {
+                if (overlapped++ == d) cut = *s;
+            }
+            if (overlapped < 2*d) continue;
+
+            ++count;
+
+            // The destination is cut at cut, so the run is cut at the position mapped there
+            ulint start = it->second + (cut - destination);
+            sources[cut] = start;
+            starts.insert(start);
+
+            queue.push_back(destination);
+            queue.push_back(cut);
+            queue.push_back(std::prev(sources.upper_bound(start))->first);
+        }
+
+        verbose("Added rows: ", count);
+
+        runs.clear();
+        for (std::pair<const ulint, ulint> &source : sources)
+        {
+            runs.push_back({source.second, 0, source.first});
+        }
+        std::sort(runs.begin(), runs.end(), [](const permute_run &a, const permute_run &b) { return a.start < b.start; });
+        for (size_t i = 0; i < runs.size(); ++i)
+        {
+            runs[i].length = ((i + 1 < runs.size()) ? runs[i + 1].start : n) - runs[i].start;
+        }
+    }
+
+    /*
+     * Builds the rows of the runs, split with parameter d if not 0. Runs are visited in order of destination, and
+     * mapped to the row holding their destination, which only moves forward.
+     */
+    void build(vector<permute_run> runs, ulint d)
+    {
+        n = 0;
+        for (permute_run &run : runs)
+        {
+            n += run.length;
+        }
+
+        this->d = d;
+        if (d > 0) split_runs(runs, d, n);
+        r = runs.size();
+
+        vector<size_t> order(r);
+        for (size_t i = 0; i < r; ++i) order[i] = i;
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return runs[a].destination < runs[b].destination; });
+
+        rows = vector<permute_row>(r);
+        for (size_t i = 0; i < r; ++i)
+        {
+            rows[i] = {runs[i].start, runs[i].length, 0, 0};
+        }
+
+        ulint curr = 0;
+        for (size_t i : order)
+        {
+            ulint destination = runs[i].destination;
+            while (rows[curr].start + rows[curr].length <= destination)
+            {
+                ++curr;
+            }
+
+            rows[i].interval = curr;
+            rows[i].offset = destination - rows[curr].start;
+        }
+
+        set_scan(detect_scan_isa());
+    }
+
+    ulint n = 0; // Length of the permutation
+    ulint r = 0; // Rows of the table
+    ulint d = 0; // Splitting parameter, 0 if not split
+
+    vector<permute_row> rows;
+
+    scan_fn<permute_row> scan = select_scan<permute_row>();
+};
+
+#endif /* end of include guard: _PERMUTE_TABLE_HH */
@@ -0,0 +1,143 @@
+/* row_io - Bulk serialization of LF/FL table rows
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file row_io.hpp
+   \brief row_io.hpp Bulk serialization of LF/FL table rows as blocks of columns
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#ifndef _ROW_IO_HH
+#define _ROW_IO_HH
+
+#include <common.hpp>
+
+#include <cstring>
+
+using namespace std;
+
+// Bytes of a serialized row: character, interval, length, offset
+#define ROW_BYTES (sizeof(char) + 3*sizeof(ulint))
+// Rows per block of columns
+#define ROW_IO_BLOCK (1 << 16)
+
+/*
+ * Rows are written in blocks of ROW_IO_BLOCK rows (the last may be shorter). Each block stores the characters,
+ * then the intervals, lengths and offsets of its rows, so a block takes four writes and the size of count rows
+ * is count * ROW_BYTES.
+ */
+inline size_t rows_bytes(size_t count)
+{
+    return count * ROW_BYTES;
+}
+
+/*
+ * \param out the ostream
+ * \param rows to write, with character, length, interval and offset fields
+ * \param number of rows
+ * \return bytes written
+ */
+template < class row_t >
+size_t write_rows(std::ostream &out, const row_t *rows, size_t count)
+{
+    size_t block_rows = std::min(count, (size_t) ROW_IO_BLOCK);
+    vector<char> characters(block_rows);
+    vector<ulint> intervals(block_rows);
+    vector<ulint> lengths(block_rows);
+    vector<ulint> offsets(block_rows);
+
+    for (size_t start = 0; start < count; start += ROW_IO_BLOCK)
+    {
+        size_t block = std::min(count - start, (size_t) ROW_IO_BLOCK);
+
+        for (size_t i = 0; i < block; ++i)
+        {
+            characters[i] = rows[start + i].character;
+            intervals[i] = rows[start + i].interval;
+            lengths[i] = rows[start + i].length;
+            offsets[i] = rows[start + i].offset;
+        }
+
+        out.write(characters.data(), block * sizeof(char));
+        out.write((char *)intervals.data(), block * sizeof(ulint));
+        out.write((char *)lengths.data(), block * sizeof(ulint));
+        out.write((char *)offsets.data(), block * sizeof(ulint));
+    }
+
+    return rows_bytes(count);
+}
+
+/*
+ * Reads rows written by write_rows
+ * \param in the istream
+ * \param rows to fill
+ * \param number of rows
+ */
+template < class row_t >
+void read_rows(std::istream &in, row_t *rows, size_t count)
+{
+    size_t block_rows = std::min(count, (size_t) ROW_IO_BLOCK);
+    vector<char> characters(block_rows);
+    vector<ulint> intervals(block_rows);
+    vector<ulint> lengths(block_rows);
+    vector<ulint> offsets(block_rows);
+
+    for (size_t start = 0; start < count; start += ROW_IO_BLOCK)
+    {
+        size_t block = std::min(count - start, (size_t) ROW_IO_BLOCK);
+
+        in.read(characters.data(), block * sizeof(char));
+        in.read((char *)intervals.data(), block * sizeof(ulint));
+        in.read((char *)lengths.data(), block * sizeof(ulint));
+        in.read((char *)offsets.data(), block * sizeof(ulint));
+
+        for (size_t i = 0; i < block; ++i)
+        {
+            rows[start + i].character = characters[i];
+            rows[start + i].interval = intervals[i];
+            rows[start + i].length = lengths[i];
+            rows[start + i].offset = offsets[i];
+        }
+    }
+}
+
+/*
+ * Reads rows of tables written before blocks of columns, stored field by field (character, interval, length, offset)
+ * \param in the istream
+ * \param rows to fill
+ * \param number of rows
+ */
+template < class row_t >
+void read_interleaved_rows(std::istream &in, row_t *rows, size_t count)
+{
+    vector<char> buffer(rows_bytes(std::min(count, (size_t) ROW_IO_BLOCK)));
+
+    for (size_t start = 0; start < count; start += ROW_IO_BLOCK)
+    {
+        size_t block = std::min(count - start, (size_t) ROW_IO_BLOCK);
+        in.read(buffer.data(), rows_bytes(block));
+
+        const char *p = buffer.data();
+        for (size_t i = start; i < start + block; ++i)
+        {
+            memcpy(&rows[i].character, p, sizeof(char));
+            memcpy(&rows[i].interval, p + 1, sizeof(ulint));
+            memcpy(&rows[i].length, p + 1 + sizeof(ulint), sizeof(ulint));
+            memcpy(&rows[i].offset, p + 1 + 2*sizeof(ulint), sizeof(ulint));
+            p += ROW_BYTES;
+        }
+    }
+}
+
+#endif /* end of include guard: _ROW_IO_HH */
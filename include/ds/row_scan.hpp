@@ -0,0 +1,233 @@
+/* row_scan - Kernels for the final scan of LF/FL, finding the row containing an offset
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file row_scan.hpp
+   \brief row_scan.hpp Scalar, AVX2 and AVX-512 kernels for the LF/FL row scan, chosen at runtime
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#ifndef _ROW_SCAN_HH
+#define _ROW_SCAN_HH
+
+#include <common.hpp>
+
+#include <cstddef>
+#include <immintrin.h>
+
+using namespace std;
+
+enum scan_isa { SCAN_SCALAR, SCAN_AVX2, SCAN_AVX512 };
+
+/*
+ * Kernels move (interval, offset) forward until offset is less than the length of its row. The vector kernels
+ * load 4 (AVX2) or 8 (AVX-512) consecutive rows, shuffle out their lengths, prefix sum them and compare against
+ * the offset, so one iteration skips that many rows. Rows must be the 32 byte layout of LF_row/FL_row
+ * (character, length, interval, offset). The last rows of the table are scanned by the scalar loop.
+ */
+template < class row_t >
+using scan_fn = std::pair<ulint, ulint> (*)(const row_t *rows, ulint r, ulint interval, ulint offset);
+
+template < class row_t >
+std::pair<ulint, ulint> scan_scalar(const row_t *rows, ulint r, ulint interval, ulint offset)
+{
+    while (offset >= rows[interval].length)
+    {
+        offset -= rows[interval++].length;
+    }
+
+    return std::make_pair(interval, offset);
+}
+
+template < class row_t >
+__attribute__((target("avx2")))
+std::pair<ulint, ulint> scan_avx2(const row_t *rows, ulint r, ulint interval, ulint offset)
+{
+    static_assert(sizeof(row_t) == 32 && offsetof(row_t, length) == 8, "Rows must be 32 bytes with length at byte 8");
+
+    const __m256i zero = _mm256_setzero_si256();
+
+    while (interval + 4 <= r)
+    {
+        const __m256i *base = (const __m256i *) (rows + interval);
+
+        // Each row is [character, length | interval, offset], so unpacking the high words pairs up lengths
+        __m256i lo = _mm256_unpackhi_epi64(_mm256_loadu_si256(base), _mm256_loadu_si256(base + 1));
+        __m256i hi = _mm256_unpackhi_epi64(_mm256_loadu_si256(base + 2), _mm256_loadu_si256(base + 3));
+        __m256i lens = _mm256_permute2x128_si256(lo, hi, 0x20);
+
+        // Inclusive prefix sum over the 4 lanes
+        __m256i sums = _mm256_add_epi64(lens, _mm256_blend_epi32(_mm256_permute4x64_epi64(lens, _MM_SHUFFLE(2, 1, 0, 0)), zero, 0x03));
+        sums = _mm256_add_epi64(sums, _mm256_blend_epi32(_mm256_permute4x64_epi64(sums, _MM_SHUFFLE(1, 0, 0, 0)), zero, 0x0F));
+
+        // Lengths are below 2^63, so the signed compare is exact
+        __m256i past = _mm256_cmpgt_epi64(sums, _mm256_set1_epi64x(offset));
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(past));
+
+        alignas(32) ulint prefix[4];
+        _mm256_store_si256((__m256i *) prefix, sums);
+
+        if (mask)
+        {
+            int k = __builtin_ctz(mask);
+            if (k) offset -= prefix[k - 1];
+            return std::make_pair(interval + k, offset);
+        }
+
+        offset -= prefix[3];
+        interval += 4;
+    }
+
+    return scan_scalar(rows, r, interval, offset);
+}
+
+template < class row_t >
+__attribute__((target("avx512f")))
+std::pair<ulint, ulint> scan_avx512(const row_t *rows, ulint r, ulint interval, ulint offset)
+{
+    static_assert(sizeof(row_t) == 32 && offsetof(row_t, length) == 8, "Rows must be 32 bytes with length at byte 8");
+
+    const __m512i length_words = _mm512_setr_epi64(1, 5, 9, 13, 1, 5, 9, 13);
+    const __m512i halves = _mm512_setr_epi64(0, 1, 2, 3, 8, 9, 10, 11);
+
+    // Lanes shifted up by 1, 2 and 4, the lanes shifted in zeroed by the mask. GCC builds alignr and shuffle_i64x2
+    // from an undefined source, warning it may be used uninitialized.
+    const __m512i shift_1 = _mm512_setr_epi64(0, 0, 1, 2, 3, 4, 5, 6);
+    const __m512i shift_2 = _mm512_setr_epi64(0, 0, 0, 1, 2, 3, 4, 5);
+    const __m512i shift_4 = _mm512_setr_epi64(0, 0, 0, 0, 0, 1, 2, 3);
+
+    while (interval + 8 <= r)
+    {
+        const __m512i *base = (const __m512i *) (rows + interval);
+
+        // Two rows per register, lengths are words 1 and 5 of each
+        __m512i lo = _mm512_permutex2var_epi64(_mm512_loadu_si512(base), length_words, _mm512_loadu_si512(base + 1));
+        __m512i hi = _mm512_permutex2var_epi64(_mm512_loadu_si512(base + 2), length_words, _mm512_loadu_si512(base + 3));
+        __m512i lens = _mm512_permutex2var_epi64(lo, halves, hi);
+
+        // Inclusive prefix sum over the 8 lanes
+        __m512i sums = _mm512_add_epi64(lens, _mm512_maskz_permutexvar_epi64(0xFE, shift_1, lens));
+        sums = _mm512_add_epi64(sums, _mm512_maskz_permutexvar_epi64(0xFC, shift_2, sums));
+        sums = _mm512_add_epi64(sums, _mm512_maskz_permutexvar_epi64(0xF0, shift_4, sums));
+
+        __mmask8 past = _mm512_cmpgt_epu64_mask(sums, _mm512_set1_epi64(offset));
+
+        alignas(64) ulint prefix[8];
+        _mm512_store_si512((__m512i *) prefix, sums);
+
+        if (past)
+        {
+            int k = __builtin_ctz(past);
+            if (k) offset -= prefix[k - 1];
+            return std::make_pair(interval + k, offset);
+        }
+
+        offset -= prefix[7];
+        interval += 8;
+    }
+
+    return scan_scalar(rows, r, interval, offset);
+}
+
+/*
+ * Kernel for tables split with parameter D, where the destination is less than 2D rows past the interval. Each block
+ * loads the lengths of up to 4 consecutive rows, and counts without branches how many of them end at or before the
+ * offset. The loop has a compile time trip count, with a single exit test per block, and block addresses do not depend
+ * on loaded lengths so they can be issued speculatively. Blocks running past the last row, or a table not meeting
+ * the bound, fall back to the scalar loop.
+ */
+template < class row_t, ulint D >
+std::pair<ulint, ulint> scan_split(const row_t *rows, ulint r, ulint interval, ulint offset)
+{
+    constexpr ulint B = (2*D < 4) ? 2*D : 4;
+
+    for (ulint block = 0; block < 2*D; block += B)
+    {
+        if (interval + B > r) break;
+
+        ulint end = 0; // End of the current row, relative to the start of the block
+        ulint passed = 0; // Total length of rows ending at or before the offset
+        ulint count = 0; // Number of such rows
+
+        #pragma GCC unroll 8
+        for (ulint i = 0; i < B; ++i)
+        {
+            ulint length = rows[interval + i].length;
+            end += length;
+
+            ulint past = end <= offset;
+            passed += length & -past;
+            count += past;
+        }
+
+        if (count < B)
+        {
+            return std::make_pair(interval + count, offset - passed);
+        }
+
+        // Advance by the constant, so the next loads do not wait on these lengths
+        interval += B;
+        offset -= passed;
+    }
+
+    return scan_scalar(rows, r, interval, offset);
+}
+
+// Best instruction set supported by the running CPU
+inline scan_isa detect_scan_isa()
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return SCAN_AVX512;
+    if (__builtin_cpu_supports("avx2")) return SCAN_AVX2;
+    return SCAN_SCALAR;
+}
+
+/*
+ * Kernel for a table split with parameter d (0 if unknown or not split), using the specialization for d if there is one,
+ * otherwise the given instruction set, falling back to scalar if it is not supported
+ */
+template < class row_t >
+scan_fn<row_t> select_scan(scan_isa isa = detect_scan_isa(), ulint d = 0)
+{
+    switch (d)
+    {
+    case 2:
+        return scan_split<row_t, 2>;
+    case 4:
+        return scan_split<row_t, 4>;
+    case 8:
+        return scan_split<row_t, 8>;
+    case 16:
+        return scan_split<row_t, 16>;
+    case 32:
+        return scan_split<row_t, 32>;
+    case 64:
+        return scan_split<row_t, 64>;
+    }
+
+    scan_isa supported = detect_scan_isa();
+    if (isa > supported) isa = supported;
+
+    switch (isa)
+    {
+    case SCAN_AVX512:
+        return scan_avx512<row_t>;
+    case SCAN_AVX2:
+        return scan_avx2<row_t>;
+    default:
+        return scan_scalar<row_t>;
+    }
+}
+
+#endif /* end of include guard: _ROW_SCAN_HH */
@@ -0,0 +1,155 @@
+/* run_column - Dynamic column of L or F holding only the positions of its set bits
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file run_column.hpp
+   \brief run_column.hpp Dynamic column supporting rank/select/set in O(r) space, used to split runs in deterministic
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#ifndef _RUN_COLUMN_HH
+#define _RUN_COLUMN_HH
+
+#include <common.hpp>
+
+#include <sdsl/structure_tree.hpp>
+#include <sdsl/util.hpp>
+
+#include <../../thirdparty/dynamic/dynamic.hpp>
+
+using namespace std;
+using namespace dyn;
+
+/*
+ * The set bits are kept as the gaps between them in a searchable partial sum (a B-tree of packed gaps), so the
+ * position of the k-th set bit is the sum of the first k + 1 gaps, and the set bits before a position are found by
+ * searching the sums for it. Each takes O(log r) time, and the column takes space in the number of set bits r rather
+ * than its length n. It has the interface of the dynamic bitvectors of DYNAMIC used by deterministic.
+ */
+class run_column
+{
+public:
+    run_column() {}
+
+    /*
+     * \param Sorted positions of the set bits
+     * \param Length of the column
+     */
+    run_column(const vector<ulint> &positions, ulint _n)
+    {
+        n = _n;
+
+        ulint last = 0;
+        for (ulint pos : positions)
+        {
+            gaps.push_back(pos - last);
+            last = pos;
+        }
+    }
+
+    ulint size()
+    {
+        return n;
+    }
+
+    ulint bits_set()
+    {
+        return gaps.size();
+    }
+
+    bool operator[](ulint i)
+    {
+        assert(i < size());
+        ulint k = rank(i);
+        return k < bits_set() && select(k) == i;
+    }
+
+    bool at(ulint i)
+    {
+        return (*this)[i];
+    }
+
+    // Number of set bits before position i
+    ulint rank(ulint i)
+    {
+        assert(i <= size());
+        if (i == 0 || bits_set() == 0) return 0;
+        if (i > gaps.psum()) return bits_set();
+
+        return gaps.search(i);
+    }
+
+    // Position of the kth set bit (from 0)
+    ulint select(ulint k)
+    {
+        assert(k < bits_set());
+        return gaps.psum(k);
+    }
+
+    // Sets the bit at position i, splitting the gap holding it
+    void set(ulint i)
+    {
+        assert(i < size());
+        ulint k = rank(i);
+        if (k == bits_set())
+        {
+            gaps.push_back(i - ((k > 0) ? select(k - 1) : 0));
+            return;
+        }
+        if (select(k) == i) return;
+
+        ulint gap = i - ((k > 0) ? select(k - 1) : 0);
+        gaps.decrement(k, gap);
+        gaps.insert(k, gap);
+    }
+
+    /* serialize to the ostream
+    * \param out     the ostream
+    */
+    size_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, std::string name ="")
+    {
+        size_t written_bytes = 0;
+
+        out.write((char *)&n, sizeof(n));
+        written_bytes += sizeof(n);
+
+        ulint r = bits_set();
+        out.write((char *)&r, sizeof(r));
+        written_bytes += sizeof(r);
+
+        // DYNAMIC cannot load an empty partial sum
+        if (r > 0) written_bytes += gaps.serialize(out);
+
+        return written_bytes;
+    }
+
+    /* load from the istream
+    * \param in the istream
+    */
+    void load(std::istream &in)
+    {
+        ulint r;
+        in.read((char *)&n, sizeof(n));
+        in.read((char *)&r, sizeof(r));
+
+        gaps = packed_spsi();
+        if (r > 0) gaps.load(in);
+    }
+
+private:
+    ulint n = 0; // Length of the column
+    packed_spsi gaps; // Distance of each set bit from the one before it (the first from 0)
+};
+
+#endif /* end of include guard: _RUN_COLUMN_HH */
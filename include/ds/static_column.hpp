@@ -24,6 +24,7 @@
 #include <common.hpp>
 
 #include <sdsl/int_vector.hpp>
+#include <sdsl/sd_vector.hpp>
 #include <sdsl/rmq_support.hpp>
 #include <sdsl/structure_tree.hpp>
 #include <sdsl/util.hpp>
@@ -45,13 +46,22 @@ private:
 public:
     static_column() {}
 
-    static_column(static_column &other)
+    static_column(const static_column &other)
     {
         col = other.col;
         rank = rank_t(&col);
         select = select_t(&col);
     }
 
+    // Supports point at the column they were built on, so they are rebuilt on the copy
+    static_column &operator=(const static_column &other)
+    {
+        col = other.col;
+        rank = rank_t(&col);
+        select = select_t(&col);
+        return *this;
+    }
+
     static_column(bit_vector bv)
     {
         col = bv_t(bv);
@@ -59,6 +69,35 @@ public:
         select = select_t(&col);
     }
 
+    /*
+     * \param Sorted positions of the set bits
+     * \param Length of the column
+     */
+    static_column(const vector<ulint> &positions, ulint n)
+    {
+        // A sparse column is built from its set bits alone, without n bits in between
+        if constexpr (std::is_same<bv_t, sd_vector<>>::value)
+        {
+            sd_vector_builder builder(n, positions.size());
+            for (ulint pos : positions)
+            {
+                builder.set(pos);
+            }
+            col = bv_t(builder);
+        }
+        else
+        {
+            bit_vector bv = bit_vector(n, false);
+            for (ulint pos : positions)
+            {
+                bv[pos] = true;
+            }
+            col = bv_t(bv);
+        }
+        rank = rank_t(&col);
+        select = select_t(&col);
+    }
+
     // Access position at bit_vector
 	bool operator[](ulint i)
     {
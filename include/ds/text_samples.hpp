@@ -0,0 +1,247 @@
+/* text_samples - Checkpoints of the walk inverting the text
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file text_samples.hpp
+   \brief text_samples.hpp Checkpoints (run, offset) every k steps of the walk inverting the text
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#ifndef _TEXT_SAMPLES_HH
+#define _TEXT_SAMPLES_HH
+
+#include <common.hpp>
+
+#include <sdsl/int_vector.hpp>
+#include <sdsl/structure_tree.hpp>
+#include <sdsl/util.hpp>
+
+#define TEXT_SAMPLES_MAGIC 0x73656c706d617354ULL
+#define TEXT_SAMPLES_VERSION 1 // Header records the table sampled
+
+using namespace std;
+using namespace sdsl;
+
+/*
+ * The LF walk from (0,0) visits the characters of the text from last to first, until the terminator. Step j of the
+ * walk (0 <= j < m) is at the character written j-th by LF_table::invert, i.e. text position m-1-j. The FL walk from
+ * FL(0,0) visits them from first to last, so step j is at text position j. Sample i is the position (run, offset) of
+ * step i*k, so a walk may start from any sample. Larger k takes less space, and walks up to k-1 more steps to reach
+ * a position.
+ */
+class text_samples
+{
+public:
+    text_samples() {}
+
+    /*
+     * Samples the LF walk, walking the whole text once
+     * \param Table to walk, supporting get_char and LF
+     * \param Steps between samples
+     */
+    template < class table_t >
+    text_samples(table_t &table, ulint period)
+        : text_samples(table, period, std::make_pair(0, 0), [&table](ulint run, ulint offset) { return table.LF(run, offset); }) {}
+
+    /*
+     * Samples any walk, walking the whole text once
+     * \param Table to walk, supporting get_char
+     * \param Steps between samples
+     * \param Position (run, offset) of the first step
+     * \param Function from a position to the position of the next step
+     */
+    template < class table_t, class step_t >
+    text_samples(table_t &table, ulint period, std::pair<ulint, ulint> start, step_t step)
+    {
+        if (period == 0) error("Sample period must be positive");
+        k = period;
+        n = table.size();
+        r = table.runs();
+        d = table.split_param();
+
+        vector<ulint> sample_runs;
+        vector<ulint> sample_offsets;
+        ulint max_run = 0;
+        ulint max_offset = 0;
+
+        ulint interval = start.first;
+        ulint offset = start.second;
+
+        m = 0;
+        while (table.get_char(interval) > TERMINATOR)
+        {
+            if (m % k == 0)
+            {
+                sample_runs.push_back(interval);
+                sample_offsets.push_back(offset);
+                max_run = std::max(max_run, interval);
+                max_offset = std::max(max_offset, offset);
+            }
+
+            std::pair<ulint, ulint> pos = step(interval, offset);
+            interval = pos.first;
+            offset = pos.second;
+            ++m;
+        }
+
+        runs = int_vector<>(sample_runs.size(), 0, bitsize(uint64_t(max_run)));
+        offsets = int_vector<>(sample_offsets.size(), 0, bitsize(uint64_t(max_offset)));
+        for (size_t i = 0; i < sample_runs.size(); ++i)
+        {
+            runs[i] = sample_runs[i];
+            offsets[i] = sample_offsets[i];
+        }
+
+        mem_stats();
+    }
+
+    // Position (run, offset) of step i*k
+    std::pair<ulint, ulint> get(size_t i) const
+    {
+        assert(i < runs.size());
+        return std::make_pair(runs[i], offsets[i]);
+    }
+
+    // Number of samples
+    ulint size() const
+    {
+        return runs.size();
+    }
+
+    // Steps between samples
+    ulint period() const
+    {
+        return k;
+    }
+
+    // Steps of the walk, i.e. characters of the text before the terminator
+    ulint steps() const
+    {
+        return m;
+    }
+
+    std::string get_file_extension() const
+    {
+        return ".text_samples";
+    }
+
+    // Whether the samples were taken from a table of this BWT, split as it is
+    template < class table_t >
+    bool matches(table_t &table) const
+    {
+        return n == table.size() && r == table.runs() && d == table.split_param();
+    }
+
+    void mem_stats()
+    {
+        sdsl::nullstream ns;
+
+        verbose("Memory consumption (bytes).");
+        verbose("          Text samples: ", serialize(ns));
+        verbose("                  runs: ", runs.serialize(ns), " (", int(runs.width()), " bits)");
+        verbose("               offsets: ", offsets.serialize(ns), " (", int(offsets.width()), " bits)");
+    }
+
+    /* serialize to the ostream
+    * \param out     the ostream
+    */
+    size_t serialize(std::ostream &out, sdsl::structure_tree_node *v = nullptr, std::string name ="")
+    {
+        size_t written_bytes = 0;
+
+        ulint magic = TEXT_SAMPLES_MAGIC;
+        out.write((char *)&magic, sizeof(magic));
+        written_bytes += sizeof(magic);
+
+        ulint version = TEXT_SAMPLES_VERSION;
+        out.write((char *)&version, sizeof(version));
+        written_bytes += sizeof(version);
+
+        out.write((char *)&n, sizeof(n));
+        written_bytes += sizeof(n);
+
+        out.write((char *)&r, sizeof(r));
+        written_bytes += sizeof(r);
+
+        out.write((char *)&d, sizeof(d));
+        written_bytes += sizeof(d);
+
+        out.write((char *)&k, sizeof(k));
+        written_bytes += sizeof(k);
+
+        out.write((char *)&m, sizeof(m));
+        written_bytes += sizeof(m);
+
+        written_bytes += runs.serialize(out, v, "runs");
+        written_bytes += offsets.serialize(out, v, "offsets");
+
+        return written_bytes;
+    }
+
+    /* load from the istream
+    * \param in the istream
+    */
+    void load(std::istream &in)
+    {
+        ulint magic;
+        in.read((char *)&magic, sizeof(magic));
+        if (magic == TEXT_SAMPLES_MAGIC)
+        {
+            ulint version;
+            in.read((char *)&version, sizeof(version));
+            if (version > TEXT_SAMPLES_VERSION) error("Text samples version", version, "is newer than supported version", TEXT_SAMPLES_VERSION);
+
+            in.read((char *)&n, sizeof(n));
+            in.read((char *)&r, sizeof(r));
+            in.read((char *)&d, sizeof(d));
+            in.read((char *)&k, sizeof(k));
+        }
+        // Samples written before the header start directly with k, and do not record their table
+        else
+        {
+            n = r = d = 0;
+            k = magic;
+        }
+        in.read((char *)&m, sizeof(m));
+
+        runs.load(in);
+        offsets.load(in);
+    }
+
+    /* load from the istream, rejecting samples not taken from this table (another BWT, or another splitting)
+    * \param in the istream
+    * \param table the samples are used with
+    */
+    template < class table_t >
+    void load(std::istream &in, table_t &table)
+    {
+        load(in);
+        if (!matches(table)) error("Text samples were taken from a table with n =", n, "r =", r, "d =", d,
+            "not this one with n =", table.size(), "r =", table.runs(), "d =", table.split_param(), ", rebuild them");
+    }
+
+private:
+    ulint k = 0; // Steps between samples
+    ulint m = 0; // Steps of the walk
+
+    // Table sampled, 0 if not recorded
+    ulint n = 0; // Length of its BWT
+    ulint r = 0; // Its rows
+    ulint d = 0; // Its splitting parameter
+
+    int_vector<> runs;
+    int_vector<> offsets;
+};
+
+#endif /* end of include guard: _TEXT_SAMPLES_HH */
@@ -0,0 +1,152 @@
+/* bench_LF - Benchmark LF stepping on the permute table layouts
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file bench_LF.cpp
+   \brief bench_LF.cpp Benchmark LF stepping (ns/step) on the permute table layouts
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#define VERBOSE
+
+#include <common.hpp>
+#include <LF_table.hpp>
+#include <packed_LF_table.hpp>
+
+#include <random>
+
+#include <sdsl/io.hpp>
+#include <sdsl/int_vector.hpp>
+
+#define SEED 23
+#define WALKS 10000
+#define STEPS 1000
+
+// Walk every start STEPS times, returning the average time of a step in nanoseconds
+template <class table_t>
+double time_walks(table_t &table, vector<pair<ulint, ulint>> &starts, ulint &checksum)
+{
+  std::chrono::high_resolution_clock::time_point t_start = std::chrono::high_resolution_clock::now();
+
+  for (size_t i = 0; i < starts.size(); ++i)
+  {
+    std::pair<ulint, ulint> pos = starts[i];
+    for (size_t j = 0; j < STEPS; ++j)
+    {
+      pos = table.LF(pos.first, pos.second);
+    }
+    checksum += pos.first + pos.second;
+  }
+
+  std::chrono::high_resolution_clock::time_point t_end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::nano>(t_end - t_start).count() / (starts.size() * STEPS);
+}
+
+// Walk every start STEPS times, advancing all walks together by LF_batch
+double time_batch(LF_table &table, vector<pair<ulint, ulint>> starts, ulint &checksum)
+{
+  std::chrono::high_resolution_clock::time_point t_start = std::chrono::high_resolution_clock::now();
+
+  for (size_t j = 0; j < STEPS; ++j)
+  {
+    table.LF_batch(starts);
+  }
+  for (size_t i = 0; i < starts.size(); ++i)
+  {
+    checksum += starts[i].first + starts[i].second;
+  }
+
+  std::chrono::high_resolution_clock::time_point t_end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::nano>(t_end - t_start).count() / (starts.size() * STEPS);
+}
+
+int main(int argc, char *const argv[])
+{
+  Args args;
+  parseArgs(argc, argv, args);
+
+  verbose("Loading the Permute Table for LF");
+
+  std::chrono::high_resolution_clock::time_point t_load_start = std::chrono::high_resolution_clock::now();
+
+  LF_table table;
+  if (args.mapped) {
+    table.map(args.filename + table.get_mapped_file_extension());
+  }
+  else {
+    std::string table_fname = args.filename + table.get_file_extension();
+    std::ifstream ifs_table(table_fname);
+    table.load(ifs_table);
+    ifs_table.close();
+  }
+
+  std::chrono::high_resolution_clock::time_point t_load_end = std::chrono::high_resolution_clock::now();
+  verbose("Load Complete");
+  verbose("Elapsed time (s): ", std::chrono::duration<double, std::ratio<1>>(t_load_end - t_load_start).count());
+
+  verbose("Packing the Permute Table");
+  packed_LF_table packed(table);
+
+  // Random starting positions, shared by every layout
+  std::mt19937 gen(SEED);
+  std::uniform_int_distribution<ulint> choose(0, table.runs() - 1);
+  vector<pair<ulint, ulint>> starts(WALKS);
+  for (size_t i = 0; i < WALKS; ++i)
+  {
+    ulint run = choose(gen);
+    starts[i] = make_pair(run, gen() % table.get(run).length);
+  }
+
+  verbose("Walking", WALKS, "positions for", STEPS, "LF steps");
+
+  ulint scalar_check = 0;
+  ulint vector_check = 0;
+  ulint table_check = 0;
+  ulint packed_check = 0;
+  ulint batch_check = 0;
+
+  table.set_scan(SCAN_SCALAR, false);
+  double scalar_ns = time_walks(table, starts, scalar_check);
+  table.set_scan(detect_scan_isa(), false);
+  double vector_ns = time_walks(table, starts, vector_check);
+  table.set_scan(detect_scan_isa(), true);
+
+  double table_ns = time_walks(table, starts, table_check);
+  double packed_ns = time_walks(packed, starts, packed_check);
+  double batch_ns = time_batch(table, starts, batch_check);
+
+  if (table_check != scalar_check) error("Table scan disagrees with scalar scan");
+  if (table_check != vector_check) error("Table scan disagrees with vector scan");
+  if (table_check != packed_check) error("Packed table disagrees with LF table");
+  if (table_check != batch_check) error("Batched LF disagrees with LF table");
+
+  sdsl::nullstream ns;
+  verbose("LF table (bytes):        ", table.serialized_size());
+  verbose("Packed LF table (bytes): ", packed.serialize(ns));
+  verbose("LF table, scalar scan (ns/step):", scalar_ns);
+  verbose("LF table, vector scan (ns/step):", vector_ns);
+  verbose("LF table, d =", table.split_param(), "(ns/step):", table_ns);
+  verbose("Packed LF table (ns/step): ", packed_ns);
+  verbose("Batched LF table (ns/step):", batch_ns);
+
+  #ifdef PRINT_STATS
+  cout << "Step scalar: " << scalar_ns << std::endl;
+  cout << "Step vector: " << vector_ns << std::endl;
+  cout << "Step table: " << table_ns << std::endl;
+  cout << "Step packed: " << packed_ns << std::endl;
+  cout << "Step batch: " << batch_ns << std::endl;
+  #endif
+
+  return 0;
+}
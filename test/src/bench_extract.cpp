@@ -0,0 +1,122 @@
+/* bench_extract - Benchmark substring extraction against the sample period
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file bench_extract.cpp
+   \brief bench_extract.cpp Benchmark extraction latency (ns/extract) and sample space for LF/FL tables, for several sample periods
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#define VERBOSE
+
+#include <common.hpp>
+#include <LF_table.hpp>
+#include <FL_table.hpp>
+#include <text_samples.hpp>
+
+#include <random>
+
+#include <sdsl/io.hpp>
+#include <sdsl/int_vector.hpp>
+
+#define SEED 23
+#define QUERIES 10000
+#define EXTRACT_LEN 100
+
+// Extract EXTRACT_LEN characters at every position, returning the average time of an extraction in nanoseconds
+template <class table_t>
+double time_extract(table_t &table, text_samples &samples, vector<ulint> &positions, ulint &checksum)
+{
+  std::chrono::high_resolution_clock::time_point t_start = std::chrono::high_resolution_clock::now();
+
+  for (size_t i = 0; i < positions.size(); ++i)
+  {
+    std::string text = table.extract(positions[i], EXTRACT_LEN, samples);
+    for (size_t j = 0; j < text.size(); ++j)
+    {
+      checksum = checksum * 31 + (uchar) text[j];
+    }
+  }
+
+  std::chrono::high_resolution_clock::time_point t_end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::nano>(t_end - t_start).count() / positions.size();
+}
+
+int main(int argc, char *const argv[])
+{
+  Args args;
+  parseArgs(argc, argv, args);
+
+  verbose("Loading the Permute Table for LF");
+
+  LF_table LF;
+  if (args.mapped) {
+    LF.map(args.filename + LF.get_mapped_file_extension());
+  }
+  else {
+    std::ifstream ifs_table(args.filename + LF.get_file_extension());
+    LF.load(ifs_table);
+    ifs_table.close();
+  }
+
+  verbose("Inverting the Permute Table for FL");
+  std::chrono::high_resolution_clock::time_point t_invert_start = std::chrono::high_resolution_clock::now();
+
+  FL_table FL(LF);
+
+  std::chrono::high_resolution_clock::time_point t_invert_end = std::chrono::high_resolution_clock::now();
+  verbose("Elapsed time (s): ", std::chrono::duration<double, std::ratio<1>>(t_invert_end - t_invert_start).count());
+
+  std::mt19937 gen(SEED);
+  vector<ulint> positions(QUERIES);
+  ulint reference = 0;
+
+  for (ulint period : {16, 64, 256, 1024, 4096})
+  {
+    verbose("Sampling every", period, "positions");
+
+    text_samples LF_samples(LF, period);
+    text_samples FL_samples = FL.sample(period);
+    if (LF_samples.steps() != FL_samples.steps()) error("LF and FL walks disagree on the text length");
+
+    if (reference == 0)
+    {
+      std::uniform_int_distribution<ulint> choose(0, LF_samples.steps() - 1);
+      for (size_t i = 0; i < QUERIES; ++i)
+      {
+        positions[i] = choose(gen);
+      }
+    }
+
+    ulint LF_check = 0;
+    ulint FL_check = 0;
+    double LF_ns = time_extract(LF, LF_samples, positions, LF_check);
+    double FL_ns = time_extract(FL, FL_samples, positions, FL_check);
+
+    if (LF_check != FL_check) error("LF and FL extraction disagree");
+    if (reference == 0) reference = LF_check;
+    if (LF_check != reference) error("Extraction depends on the sample period");
+
+    sdsl::nullstream ns;
+    ulint bytes = LF_samples.serialize(ns);
+
+    verbose("Period", period, "- samples (bytes):", bytes, "LF (ns/extract):", LF_ns, "FL (ns/extract):", FL_ns);
+
+    #ifdef PRINT_STATS
+    cout << "Extract " << period << ": " << bytes << " bytes, LF " << LF_ns << " ns, FL " << FL_ns << " ns" << std::endl;
+    #endif
+  }
+
+  return 0;
+}
@@ -0,0 +1,109 @@
+/* bench_split - Benchmark the deterministic and offline splitting of runs
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file bench_split.cpp
+   \brief bench_split.cpp Benchmark splitting runs with deterministic and offline_balance (time, memory, rows and scan)
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#define VERBOSE
+
+#include <common.hpp>
+#include <split_LF.hpp>
+#include <offline_balance.hpp>
+#include <rlbwt_reader.hpp>
+
+#include <sdsl/int_vector.hpp>
+#include <malloc_count.h>
+
+// Most rows of L a row of F covers the heads of, which must be less than 2d
+ulint max_scan(const rlbwt_reader &rlbwt, const split_positions &splits)
+{
+  LF_table table(rlbwt, splits);
+
+  vector<ulint> start(table.runs() + 1, 0);
+  for (ulint i = 0; i < table.runs(); ++i)
+  {
+    start[i + 1] = start[i] + table.get(i).length;
+  }
+
+  ulint max_heads = 0;
+  for (ulint i = 0; i < table.runs(); ++i)
+  {
+    LF_table::LF_row row = table.get(i);
+    ulint F_start = start[row.interval] + row.offset;
+    ulint first = std::lower_bound(start.begin(), start.end(), F_start) - start.begin();
+    ulint last = std::lower_bound(start.begin(), start.end(), F_start + row.length) - start.begin();
+    max_heads = std::max(max_heads, last - first);
+  }
+
+  return max_heads;
+}
+
+// Builds the splitter and splits, returning the splitting and reporting its time, memory, rows and scan
+template <class splitter_t>
+split_positions time_split(std::string name, const rlbwt_reader &rlbwt, ulint d)
+{
+  verbose("Splitting with", name);
+
+  malloc_count_reset_peak();
+  size_t mem_start = malloc_count_current();
+  std::chrono::high_resolution_clock::time_point t_start = std::chrono::high_resolution_clock::now();
+
+  split_positions splits;
+  {
+    splitter_t splitter(rlbwt);
+    splits = splitter.build(d);
+  }
+
+  std::chrono::high_resolution_clock::time_point t_end = std::chrono::high_resolution_clock::now();
+  double seconds = std::chrono::duration<double, std::ratio<1>>(t_end - t_start).count();
+  size_t mem_peak = malloc_count_peak() - mem_start;
+
+  ulint rows = splits.count();
+  ulint scan = max_scan(rlbwt, splits);
+  if (scan >= 2*d) error(name, "left a row covering", scan, "heads, d =", d);
+
+  verbose(name, "(s): ", seconds);
+  verbose(name, "memory peak (bytes): ", mem_peak);
+  verbose(name, "rows: ", rows);
+  verbose(name, "max scan: ", scan);
+
+  #ifdef PRINT_STATS
+  cout << name << " time: " << seconds << std::endl;
+  cout << name << " memory: " << mem_peak << std::endl;
+  cout << name << " rows: " << rows << std::endl;
+  cout << name << " scan: " << scan << std::endl;
+  #endif
+
+  return splits;
+}
+
+int main(int argc, char *const argv[])
+{
+  Args args;
+  parseArgs(argc, argv, args);
+
+  if (args.d < 2) error("Splitting parameter must be at least 2");
+
+  rlbwt_reader rlbwt(args.filename + ".bwt");
+  verbose("Splitting", rlbwt.runs(), "runs with d =", args.d);
+
+  time_split<deterministic<sdsl::bit_vector, suc_bv>>("deterministic (bitvectors)", rlbwt, args.d);
+  time_split<deterministic<sdsl::sd_vector<>>>("deterministic", rlbwt, args.d);
+  time_split<offline_balance>("offline_balance", rlbwt, args.d);
+
+  return 0;
+}
@@ -0,0 +1,107 @@
+/* bench_walkers - Benchmark coroutine-interleaved LF walkers against the plain loop
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file bench_walkers.cpp
+   \brief bench_walkers.cpp Benchmark coroutine-interleaved LF walkers (steps/s) against the plain loop
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#define VERBOSE
+
+#include <common.hpp>
+#include <LF_table.hpp>
+#include <LF_walker.hpp>
+
+#include <random>
+
+#include <sdsl/io.hpp>
+#include <sdsl/int_vector.hpp>
+
+#define SEED 23
+#define WALKS 10000
+#define STEPS 1000
+
+int main(int argc, char *const argv[])
+{
+  Args args;
+  parseArgs(argc, argv, args);
+
+  verbose("Loading the Permute Table for LF");
+
+  LF_table table;
+  std::string table_fname = args.filename + table.get_file_extension();
+  std::ifstream ifs_table(table_fname);
+  table.load(ifs_table);
+  ifs_table.close();
+
+  std::mt19937 gen(SEED);
+  std::uniform_int_distribution<ulint> choose(0, table.runs() - 1);
+  vector<pair<ulint, ulint>> starts(WALKS);
+  for (size_t i = 0; i < WALKS; ++i)
+  {
+    ulint run = choose(gen);
+    starts[i] = make_pair(run, gen() % table.get(run).length);
+  }
+
+  verbose("Walking", WALKS, "positions for", STEPS, "LF steps");
+
+  // Plain loop, one walk at a time
+  ulint plain_check = 0;
+  std::chrono::high_resolution_clock::time_point t_start = std::chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < WALKS; ++i)
+  {
+    std::pair<ulint, ulint> pos = starts[i];
+    for (size_t j = 0; j < STEPS; ++j)
+    {
+      pos = table.LF(pos.first, pos.second);
+    }
+    plain_check += pos.first + pos.second;
+  }
+  std::chrono::high_resolution_clock::time_point t_end = std::chrono::high_resolution_clock::now();
+
+  double plain_rate = (double(WALKS) * STEPS) / std::chrono::duration<double, std::ratio<1>>(t_end - t_start).count();
+  verbose("Plain loop (steps/s):         ", plain_rate);
+
+  #ifdef PRINT_STATS
+  cout << "Steps plain: " << plain_rate << std::endl;
+  #endif
+
+  // Interleaved walkers, for increasing number of walkers per thread
+  vector<pair<ulint, ulint>> ends(WALKS);
+  for (size_t width : {1, 4, 8, 16, 32, 64})
+  {
+    LF_scheduler scheduler(width);
+
+    t_start = std::chrono::high_resolution_clock::now();
+    scheduler.run(WALKS, [&](ulint i) { return LF_walk(table, starts[i], STEPS, ends[i]); });
+    t_end = std::chrono::high_resolution_clock::now();
+
+    ulint walker_check = 0;
+    for (size_t i = 0; i < WALKS; ++i)
+    {
+      walker_check += ends[i].first + ends[i].second;
+    }
+    if (walker_check != plain_check) error("Walkers disagree with plain loop");
+
+    double walker_rate = (double(WALKS) * STEPS) / std::chrono::duration<double, std::ratio<1>>(t_end - t_start).count();
+    verbose("Walkers, width", width, "(steps/s):", walker_rate);
+
+    #ifdef PRINT_STATS
+    cout << "Steps walkers " << width << ": " << walker_rate << std::endl;
+    #endif
+  }
+
+  return 0;
+}
@@ -29,13 +29,14 @@
 #include <deterministic.hpp>
 #include <static_column.hpp>
 #include <FL_table.hpp>
+#include <rlbwt_reader.hpp>
 
 #include <sdsl/io.hpp>
 #include <sdsl/int_vector.hpp>
 #include <sdsl/sd_vector.hpp>
 #include <malloc_count.h>
 
-typedef bit_vector bv_t;
+typedef sd_vector<> bv_t;
 
 int main(int argc, char *const argv[])
 {
@@ -47,14 +48,8 @@ int main(int argc, char *const argv[])
 
   std::string bwt_fname = args.filename + ".bwt";
 
-  std::string bwt_heads_fname = bwt_fname + ".heads";
-  std::ifstream ifs_heads(bwt_heads_fname);
-  std::string bwt_len_fname = bwt_fname + ".len";
-  std::ifstream ifs_len(bwt_len_fname);
-
-  ifs_heads.seekg(0);
-  ifs_len.seekg(0);
-  constructor<bv_t> construct(ifs_heads, ifs_len);
+  rlbwt_reader rlbwt(bwt_fname);
+  constructor<bv_t> construct(rlbwt);
 
   std::chrono::high_resolution_clock::time_point t_insert_end = std::chrono::high_resolution_clock::now();
 
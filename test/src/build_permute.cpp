@@ -21,6 +21,10 @@
 #define VERBOSE
 
 #include "LF_table.hpp"
+#include "packed_LF_table.hpp"
+#include "text_samples.hpp"
+#include <rlbwt_reader.hpp>
+#include <bwt_reader.hpp>
 #include <common.hpp>
 #include <sdsl/io.hpp>
 #include <sdsl/int_vector.hpp>
@@ -38,23 +42,57 @@ int main(int argc, char *const argv[])
   std::chrono::high_resolution_clock::time_point t_insert_start = std::chrono::high_resolution_clock::now();
 
   std::string bwt_fname = args.filename + ".bwt";
-  std::string bwt_heads_fname = bwt_fname + ".heads";
-  std::ifstream ifs_heads(bwt_heads_fname);
-  std::string bwt_len_fname = bwt_fname + ".len";
-  std::ifstream ifs_len(bwt_len_fname);
 
   LF_table rif;
 
+  // The table records the d the splitting was built with (0 if unknown), whatever -d is given
+  split_positions run_splits;
+  std::string splits_fname = args.filename + run_splits.get_file_extension();
+
+  if (args.budget) {
+    if (args.packed || args.sample_period) error("External builds only write the table, plain or mapped");
+    if (args.stream) error("External builds read the BWT twice, so it cannot come from standard input; write it to <FASTA>.bwt first");
+
+    std::string outfile = args.filename + (args.mapped ? rif.get_mapped_file_extension() : rif.get_file_extension());
+    ulint budget = args.budget << 20;
+    verbose("Building externally, buffering", budget, "bytes");
+
+    if (args.rle) {
+      rlbwt_reader rlbwt(bwt_fname);
+      if (args.d) LF_table::build_external(rlbwt, splits_fname, outfile, budget, args.mapped);
+      else LF_table::build_external(rlbwt, outfile, budget, args.mapped);
+    }
+    else {
+      bwt_reader bwt(bwt_fname, args.threads);
+      if (args.d) LF_table::build_external(bwt, splits_fname, outfile, budget, args.mapped);
+      else LF_table::build_external(bwt, outfile, budget, args.mapped);
+    }
+
+    std::chrono::high_resolution_clock::time_point t_external_end = std::chrono::high_resolution_clock::now();
+    verbose("Construction Complete");
+    verbose("Memory peak: ", malloc_count_peak());
+    verbose("Elapsed time (s): ", std::chrono::duration<double, std::ratio<1>>(t_external_end - t_insert_start).count());
+
+    return 0;
+  }
+
   if (args.d) {
-    std::string splitting_filename = args.filename + ".d_col";
-    std::ifstream ifs_split(splitting_filename);
-    sdsl::bit_vector run_splits;
-    run_splits.load(ifs_split);
+    std::ifstream in_splits(splits_fname);
+    if (!in_splits.is_open()) error("Cannot open splitting", splits_fname);
+    run_splits.load(in_splits);
+    in_splits.close();
+    verbose("Splitting built with d =", run_splits.split_param());
+  }
 
-    rif = LF_table(ifs_heads, ifs_len, run_splits);
+  if (args.rle || args.stream) {
+    rlbwt_reader rlbwt = args.stream ? rlbwt_reader(std::cin) : rlbwt_reader(bwt_fname);
+    rif = args.d ? LF_table(rlbwt, run_splits, args.threads, args.low_memory)
+                 : LF_table(rlbwt, 0, args.threads, args.low_memory);
   }
   else {
-    rif = LF_table(ifs_heads, ifs_len);
+    bwt_reader bwt(bwt_fname, args.threads);
+    rif = args.d ? LF_table(bwt, run_splits, args.threads, args.low_memory)
+                 : LF_table(bwt, 0, args.threads, args.low_memory);
   }
 
   std::chrono::high_resolution_clock::time_point t_insert_end = std::chrono::high_resolution_clock::now();
@@ -68,10 +106,36 @@ int main(int argc, char *const argv[])
 
   verbose("Serializing Table");
 
-  std::string outfile = args.filename + rif.get_file_extension();
-  std::ofstream out(outfile);
-  rif.serialize(out);
-  out.close();
+  if (args.packed) {
+    packed_LF_table packed_rif(rif);
+
+    std::string outfile = args.filename + packed_rif.get_file_extension();
+    std::ofstream out(outfile);
+    packed_rif.serialize(out);
+    out.close();
+  }
+  else if (args.mapped) {
+    std::string outfile = args.filename + rif.get_mapped_file_extension();
+    std::ofstream out(outfile);
+    rif.serialize_mapped(out);
+    out.close();
+  }
+  else {
+    std::string outfile = args.filename + rif.get_file_extension();
+    std::ofstream out(outfile);
+    rif.serialize(out);
+    out.close();
+  }
+
+  if (args.sample_period) {
+    verbose("Sampling the text every", args.sample_period, "positions");
+    text_samples samples(rif, args.sample_period);
+
+    std::string outfile = args.filename + samples.get_file_extension();
+    std::ofstream out(outfile);
+    samples.serialize(out);
+    out.close();
+  }
   t_insert_end = std::chrono::high_resolution_clock::now();
 
   verbose("Memory peak: ", malloc_count_peak());
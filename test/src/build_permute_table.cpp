@@ -0,0 +1,64 @@
+/* build_permute_table - Build the table of a general permutation
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file build_permute_table.cpp
+   \brief build_permute_table.cpp Build the table of a permutation stored as 64-bit values (e.g. phi), split with parameter d
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#define VERBOSE
+
+#include <common.hpp>
+#include <permute_table.hpp>
+
+#include <sdsl/io.hpp>
+#include <sdsl/int_vector.hpp>
+#include <malloc_count.h>
+
+int main(int argc, char *const argv[])
+{
+  Args args;
+  parseArgs(argc, argv, args);
+
+  if (args.d < 0 || args.d == 1) error("Splitting parameter must be at least 2 (0 to not split)");
+
+  verbose("Building the Permute Table, with bound d =", args.d);
+  std::chrono::high_resolution_clock::time_point t_insert_start = std::chrono::high_resolution_clock::now();
+
+  permute_table table(args.filename, args.d);
+
+  std::chrono::high_resolution_clock::time_point t_insert_end = std::chrono::high_resolution_clock::now();
+
+  table.mem_stats();
+  table.permutation_stats();
+
+  verbose("Construction Complete");
+  verbose("Memory peak: ", malloc_count_peak());
+  verbose("Elapsed time (s): ", std::chrono::duration<double, std::ratio<1>>(t_insert_end - t_insert_start).count());
+
+  verbose("Serializing Table");
+
+  std::string outfile = args.filename + table.get_file_extension();
+  std::ofstream out(outfile);
+  table.serialize(out);
+  out.close();
+
+  t_insert_end = std::chrono::high_resolution_clock::now();
+
+  verbose("Memory peak: ", malloc_count_peak());
+  verbose("Elapsed time (s): ", std::chrono::duration<double, std::ratio<1>>(t_insert_end - t_insert_start).count());
+
+  return 0;
+}
@@ -0,0 +1,105 @@
+/* build_split_permute - Build the split LF table from the RLBWT in a single process
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file build_split_permute.cpp
+   \brief build_split_permute.cpp Build the split LF table from the RLBWT, replacing build_constructor, run_constructor and build_permute
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#include <iostream>
+
+#define VERBOSE
+
+#include <common.hpp>
+
+#include <split_LF.hpp>
+#include <packed_LF_table.hpp>
+#include <text_samples.hpp>
+#include <rlbwt_reader.hpp>
+
+#include <sdsl/io.hpp>
+#include <sdsl/int_vector.hpp>
+#include <malloc_count.h>
+
+int main(int argc, char *const argv[])
+{
+  Args args;
+  parseArgs(argc, argv, args);
+
+  if (args.d < 2) error("Splitting parameter must be at least 2");
+
+  verbose("Building the Split Permute Table for LF, with bound d =", args.d);
+  std::chrono::high_resolution_clock::time_point t_insert_start = std::chrono::high_resolution_clock::now();
+
+  std::string bwt_fname = args.filename + ".bwt";
+  rlbwt_reader rlbwt = args.stream ? rlbwt_reader(std::cin) : rlbwt_reader(bwt_fname);
+
+  std::string checkpoint = args.checkpoint ? args.filename + ".d_col" : "";
+  LF_table rif = args.offline ? build_split_LF_table<offline_balance>(rlbwt, args.d, args.threads, args.low_memory, checkpoint)
+                              : build_split_LF_table(rlbwt, args.d, args.threads, args.low_memory, checkpoint);
+
+  std::chrono::high_resolution_clock::time_point t_insert_end = std::chrono::high_resolution_clock::now();
+
+  rif.mem_stats();
+  rif.bwt_stats();
+
+  verbose("Construction Complete");
+  verbose("Memory peak: ", malloc_count_peak());
+  verbose("Elapsed time (s): ", std::chrono::duration<double, std::ratio<1>>(t_insert_end - t_insert_start).count());
+
+  verbose("Serializing Table");
+  std::chrono::high_resolution_clock::time_point t_insert_mid = std::chrono::high_resolution_clock::now();
+
+  if (args.packed) {
+    packed_LF_table packed_rif(rif);
+
+    std::string outfile = args.filename + packed_rif.get_file_extension();
+    std::ofstream out(outfile);
+    packed_rif.serialize(out);
+    out.close();
+  }
+  else if (args.mapped) {
+    std::string outfile = args.filename + rif.get_mapped_file_extension();
+    std::ofstream out(outfile);
+    rif.serialize_mapped(out);
+    out.close();
+  }
+  else {
+    std::string outfile = args.filename + rif.get_file_extension();
+    std::ofstream out(outfile);
+    rif.serialize(out);
+    out.close();
+  }
+
+  if (args.sample_period) {
+    verbose("Sampling the text every", args.sample_period, "positions");
+    text_samples samples(rif, args.sample_period);
+
+    std::string outfile = args.filename + samples.get_file_extension();
+    std::ofstream out(outfile);
+    samples.serialize(out);
+    out.close();
+  }
+  t_insert_end = std::chrono::high_resolution_clock::now();
+
+  verbose("Serializing Complete");
+  verbose("Elapsed time (s): ", std::chrono::duration<double, std::ratio<1>>(t_insert_end - t_insert_mid).count());
+
+  verbose("Done");
+  verbose("Memory peak: ", malloc_count_peak());
+  verbose("Total Elapsed time (s): ", std::chrono::duration<double, std::ratio<1>>(t_insert_end - t_insert_start).count());
+
+  return 0;
+}
@@ -0,0 +1,115 @@
+/* insert_permute - Insert texts into the dynamic LF table of a collection
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file insert_permute.cpp
+   \brief insert_permute.cpp Insert a text into the dynamic LF table of a collection, writing its LF table
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#define VERBOSE
+
+#include <common.hpp>
+#include <dynamic_LF_table.hpp>
+
+#include <sdsl/io.hpp>
+#include <sdsl/int_vector.hpp>
+#include <malloc_count.h>
+
+// Sequence of a file, without line breaks
+std::string read_text(std::string fname)
+{
+  std::ifstream in(fname);
+  if (!in.is_open()) error("Cannot open text file", fname);
+
+  std::string text;
+  char c;
+  while (in.get(c))
+  {
+    if (c != '\n' && c != '\r') text.push_back(c);
+  }
+
+  return text;
+}
+
+int main(int argc, char *const argv[])
+{
+  // The text inserted is the last argument, the collection is parsed as usual
+  if (argc < 3) error("Usage: insert_permute [options] <FASTA> <TEXT>");
+  std::string text_fname = argv[argc - 1];
+
+  Args args;
+  parseArgs(argc - 1, argv, args);
+  if (args.d < 0 || args.d == 1) error("Splitting parameter must be at least 2 (0 to not split)");
+
+  std::string out_fname = args.filename + ".dynamic";
+
+  verbose("Inserting", text_fname, "into the Dynamic Permute Table of", args.filename);
+  std::chrono::high_resolution_clock::time_point t_insert_start = std::chrono::high_resolution_clock::now();
+
+  // Texts inserted earlier are kept in the dynamic table, else it starts from the static table
+  dynamic_LF_table dynamic;
+  std::string dynamic_fname = args.filename + dynamic.get_file_extension();
+  std::ifstream ifs_dynamic(dynamic_fname);
+  if (ifs_dynamic.is_open())
+  {
+    dynamic.load(ifs_dynamic);
+    ifs_dynamic.close();
+  }
+  else
+  {
+    LF_table table;
+    std::ifstream ifs_table(args.filename + table.get_file_extension());
+    table.load(ifs_table);
+    ifs_table.close();
+
+    dynamic = dynamic_LF_table(table);
+  }
+
+  // Rows are cut only around the characters inserted, unless the splitting parameter changes
+  if ((ulint) args.d != dynamic.split_param()) dynamic.split_rows(args.d);
+  dynamic.insert(read_text(text_fname));
+
+  std::ofstream out_dynamic(dynamic_fname);
+  dynamic.serialize(out_dynamic);
+  out_dynamic.close();
+
+  verbose("Rows of the BWT: ", dynamic.runs());
+  verbose("Length of the BWT: ", dynamic.size());
+
+  std::chrono::high_resolution_clock::time_point t_insert_mid = std::chrono::high_resolution_clock::now();
+
+  verbose("Insertion Complete");
+  verbose("Memory peak: ", malloc_count_peak());
+  verbose("Elapsed time (s): ", std::chrono::duration<double, std::ratio<1>>(t_insert_mid - t_insert_start).count());
+
+  verbose("Writing the Permute Table for LF of the BWT");
+
+  // The rows are already split, so the table takes them as they are
+  LF_table rif = LF_table::from_rows([&](auto emit) { return dynamic.for_each_row(emit); }, dynamic.split_param(), args.threads);
+
+  std::string outfile = out_fname + rif.get_file_extension();
+  std::ofstream out(outfile);
+  rif.serialize(out);
+  out.close();
+
+  std::chrono::high_resolution_clock::time_point t_insert_end = std::chrono::high_resolution_clock::now();
+
+  verbose("Construction Complete");
+  verbose("Memory peak: ", malloc_count_peak());
+  verbose("Elapsed time (s): ", std::chrono::duration<double, std::ratio<1>>(t_insert_end - t_insert_mid).count());
+  verbose("Total Elapsed time (s): ", std::chrono::duration<double, std::ratio<1>>(t_insert_end - t_insert_start).count());
+
+  return 0;
+}
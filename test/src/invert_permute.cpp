@@ -0,0 +1,85 @@
+/* invert_permute - Reconstruct the text from the LF table
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file invert_permute.cpp
+   \brief invert_permute.cpp Reconstruct the text from the LF table, in parallel if text samples were built
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#define VERBOSE
+
+#include <common.hpp>
+#include <LF_table.hpp>
+#include <text_samples.hpp>
+
+#include <sdsl/io.hpp>
+#include <sdsl/int_vector.hpp>
+#include <malloc_count.h>
+
+int main(int argc, char *const argv[])
+{
+  Args args;
+  parseArgs(argc, argv, args);
+
+  verbose("Loading the Permute Table for LF");
+  std::chrono::high_resolution_clock::time_point t_start = std::chrono::high_resolution_clock::now();
+
+  LF_table table;
+  if (args.mapped) {
+    table.map(args.filename + table.get_mapped_file_extension());
+  }
+  else {
+    std::ifstream ifs_table(args.filename + table.get_file_extension());
+    table.load(ifs_table);
+    ifs_table.close();
+  }
+
+  text_samples samples;
+  std::ifstream ifs_samples(args.filename + samples.get_file_extension());
+  bool sampled = ifs_samples.good();
+  if (sampled) {
+    samples.load(ifs_samples, table);
+    ifs_samples.close();
+  }
+
+  std::chrono::high_resolution_clock::time_point t_load = std::chrono::high_resolution_clock::now();
+  verbose("Load time (s): ", std::chrono::duration<double, std::ratio<1>>(t_load - t_start).count());
+
+  std::string outfile = args.filename + ".inverted";
+  if (sampled) {
+    verbose("Inverting with", args.threads, "threads, samples every", samples.period(), "positions");
+    table.invert(outfile, samples, args.threads, args.forward);
+  }
+  else if (args.forward) {
+    verbose("No text samples, inverting sequentially");
+    table.invert_forward(outfile);
+  }
+  else {
+    verbose("No text samples, inverting sequentially");
+    table.invert(outfile);
+  }
+
+  std::chrono::high_resolution_clock::time_point t_end = std::chrono::high_resolution_clock::now();
+  double seconds = std::chrono::duration<double, std::ratio<1>>(t_end - t_load).count();
+
+  verbose("Memory peak: ", malloc_count_peak());
+  verbose("Invert time (s): ", seconds);
+
+  #ifdef PRINT_STATS
+  cout << "Invert time: " << seconds << std::endl;
+  #endif
+
+  return 0;
+}
@@ -0,0 +1,94 @@
+/* merge_permute - Add the texts of one LF table to those of another
+    Copyright (C) 2022 Nathaniel Brown
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see http://www.gnu.org/licenses/ .
+*/
+/*!
+   \file merge_permute.cpp
+   \brief merge_permute.cpp Merge the LF tables of two collections into the RLBWT and LF table of both
+   \author Nathaniel Brown
+   \date 16/10/2022
+*/
+
+#define VERBOSE
+
+#include <common.hpp>
+#include <LF_merge.hpp>
+#include <split_LF.hpp>
+#include <rlbwt_reader.hpp>
+
+#include <sdsl/io.hpp>
+#include <sdsl/int_vector.hpp>
+#include <malloc_count.h>
+
+LF_table load_table(std::string fname)
+{
+  LF_table table;
+  std::ifstream ifs_table(fname + table.get_file_extension());
+  table.load(ifs_table);
+  ifs_table.close();
+
+  return table;
+}
+
+int main(int argc, char *const argv[])
+{
+  // The collection added is the last argument, the other is parsed as usual
+  if (argc < 3) error("Usage: merge_permute [options] <FASTA_A> <FASTA_B>");
+  std::string B_fname = argv[argc - 1];
+
+  Args args;
+  parseArgs(argc - 1, argv, args);
+  if (args.d < 0 || args.d == 1) error("Splitting parameter must be at least 2 (0 to not split)");
+
+  std::string out_fname = args.filename + ".merged";
+
+  verbose("Merging the Permute Tables of", args.filename, "and", B_fname);
+  std::chrono::high_resolution_clock::time_point t_insert_start = std::chrono::high_resolution_clock::now();
+
+  {
+    LF_table A = load_table(args.filename);
+    LF_table B = load_table(B_fname);
+
+    LF_merge merge(A, B);
+    ulint runs = merge.write(out_fname + ".bwt");
+
+    verbose("Runs of the merged BWT: ", runs);
+    verbose("Length of the merged BWT: ", merge.size());
+  }
+
+  std::chrono::high_resolution_clock::time_point t_insert_mid = std::chrono::high_resolution_clock::now();
+
+  verbose("Merge Complete");
+  verbose("Memory peak: ", malloc_count_peak());
+  verbose("Elapsed time (s): ", std::chrono::duration<double, std::ratio<1>>(t_insert_mid - t_insert_start).count());
+
+  verbose("Building the Permute Table for LF of the merged BWT");
+
+  rlbwt_reader rlbwt(out_fname + ".bwt");
+  std::string checkpoint = args.checkpoint ? out_fname + ".d_col" : "";
+  LF_table rif = args.d ? build_split_LF_table(rlbwt, args.d, args.threads, args.low_memory, checkpoint)
+                        : LF_table(rlbwt, 0, args.threads, args.low_memory);
+
+  std::string outfile = out_fname + rif.get_file_extension();
+  std::ofstream out(outfile);
+  rif.serialize(out);
+  out.close();
+
+  std::chrono::high_resolution_clock::time_point t_insert_end = std::chrono::high_resolution_clock::now();
+
+  verbose("Construction Complete");
+  verbose("Memory peak: ", malloc_count_peak());
+  verbose("Elapsed time (s): ", std::chrono::duration<double, std::ratio<1>>(t_insert_end - t_insert_mid).count());
+  verbose("Total Elapsed time (s): ", std::chrono::duration<double, std::ratio<1>>(t_insert_end - t_insert_start).count());
+
+  return 0;
+}
@@ -35,13 +35,14 @@
 #include <sdsl/sd_vector.hpp>
 #include <malloc_count.h>
 
-typedef bit_vector bv_t;
+typedef sd_vector<> bv_t;
 
 int main(int argc, char *const argv[])
 {
   Args args;
   parseArgs(argc, argv, args);
 
+  if (args.d < 2) error("Splitting parameter must be at least 2");
   ulint d = args.d;
 
   verbose("Loading Deterministic Constructor");
@@ -65,7 +66,7 @@ int main(int argc, char *const argv[])
   verbose("Building Deterministic Splitting, with bound d =", d);
   t_insert_mid = std::chrono::high_resolution_clock::now();
 
-  bv_t final_col = deter.build(d);
+  split_positions final_col = deter.build(d);
 
   std::chrono::high_resolution_clock::time_point t_insert_end = std::chrono::high_resolution_clock::now();
   verbose("Splitting Complete");
@@ -76,7 +77,7 @@ int main(int argc, char *const argv[])
 
   t_insert_mid = std::chrono::high_resolution_clock::now();
 
-  std::string outfile_deter = args.filename + ".d_col";
+  std::string outfile_deter = args.filename + final_col.get_file_extension();
   std::ofstream out_d(outfile_deter);
   final_col.serialize(out_d);
   out_d.close();